@@ -54,6 +54,35 @@
 //    +--------------+===================+--------------------------------------+
 //     <- one page -> <---          max_heap_size            ---> <- one page ->
 //
+// ds_setmprotect() selects how the area past the brk pointer is protected:
+// - pm_Full: every ds_sbrk() re-protects the whole segment with two mprotect() calls.
+// - pm_Incremental (default): same layout as pm_Full, but ds_sbrk() only changes the protection of
+//   the pages between the old and the new page-aligned brk (prot_brk), and makes no call at all
+//   if brk stays within the same page.
+// - pm_Guard: the heap area is read/write except for a single PROT_NONE guard page at the page-
+//   aligned brk. Moving the guard costs two single-page mprotect() calls, however far brk moves.
+//   Overruns by more than a page past brk go undetected.
+// - pm_Off: the whole heap area is read/write; ds_sbrk() makes no mprotect() calls.
+//
+//
+// Memory is reserved, not committed: pages are faulted in on first access, and ds_sbrk() returns
+// the pages above a lowered brk pointer to the system with madvise(MADV_DONTNEED), so the resident
+// set follows the heap size. ds_decommit() does the same for the whole pages of a range below brk
+// that the caller no longer needs; they read as zero when touched again. ds_setpopulate(1)
+// prefaults new segments and regions instead, which trades startup time and memory for fewer page
+// faults while the heap grows.
+//
+//
+// Huge pages:
+// -----------
+// ds_setpagemode() selects the page size of new segments: pg_THP advises the kernel to back the
+// segment with 2 MiB transparent huge pages, pg_HugeTLB maps it from the hugetlbfs pool with
+// MAP_HUGETLB and falls back to pg_THP if the pool is empty. In both modes the segment is aligned
+// to 2 MiB, and guard pages, protection changes, and decommits operate on whole huge pages so that
+// they never split one. Overruns are then only caught beyond the huge page containing brk.
+// pg_Small disables transparent huge pages for the segment, pg_Default leaves the choice to the
+// system. ds_getpagesize() always reports the base page size.
+//
 //
 // Operation:
 // ----------
@@ -69,9 +98,41 @@
 // ds_release() releases all memory and resets all internal variables. A subsequent call to
 // ds_allocate() is supported and initializes a 'fresh' heap.
 //
+// Multiple segments:
+// ------------------
+// Up to DS_MAXSEG independent data segments can exist at the same time. The segment created by
+// ds_allocate() has id 0 and is the one operated on by ds_sbrk() and ds_heap_stat().
+// ds_allocate_seg() creates additional segments; the _seg variants of the functions above take
+// the id of the segment to operate on. Each segment has its own guard pages, brk pointer and
+// sbrk counter, so segments can be grown concurrently by different threads. ds_allocate() and
+// ds_release() release all segments.
+//
+// Mapped regions:
+// ---------------
+// ds_map_region() maps a page-granular region outside of all data segments for large blocks;
+// ds_unmap_region() returns it to the operating system immediately. Regions have no guard pages:
+// a guard page splits the mapping, and with many live regions the process would run into the
+// kernel's limit on the number of mappings. Regions are not part of any data segment and
+// survive ds_release(); their owner must unmap them. ds_remap_region() resizes a region with
+// mremap(): the pages move to the new location without being copied, so resizing costs the same
+// for any region size. ds_region_stat() reports the number of mappings and the current and peak
+// number of mapped bytes.
+//
+// Background prefaulting:
+// -----------------------
+// ds_setprefault() starts a helper thread that faults in the pages up to a given distance past
+// the page-aligned brk of every segment, so that the first write to memory obtained by ds_sbrk()
+// does not take a page fault. ds_sbrk() wakes the helper whenever a brk pointer grows. The helper
+// works in chunks of PREFAULT_CHUNK bytes under the lock of the segment: it makes the chunk
+// read/write, populates it, and restores the protection of the current mode, so overruns past
+// brk are still caught. The pages stay resident until brk shrinks below them.
+//
 
+#define _GNU_SOURCE
 #include <assert.h>
 #include <errno.h>
+#include <pthread.h>
+#include <sched.h>
 #include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -82,17 +143,45 @@
 #include "dataseg.h"
 
 
-static void *ds_start = NULL;       ///< start of the data segment
-static void *ds_end   = NULL;       ///< end of the data segment
-static void *ds_heap_start = NULL;  ///< start of the user space heap
-static void *ds_heap_brk   = NULL;  ///< current logical end of the user space heap
-static void *ds_heap_end   = NULL;  ///< end of the user space heap
+#define HUGE_PAGESIZE (1UL<<21)     ///< size of a huge page
+#define PREFAULT_CHUNK (1UL<<18)    ///< bytes prefaulted per step of the helper thread
+
+/// @brief a simulated data segment
+typedef struct {
+  void    *start;                   ///< start of the data segment
+  void    *end;                     ///< end of the data segment
+  void    *heap_start;              ///< start of the user space heap
+  void    *heap_brk;                ///< current logical end of the user space heap
+  void    *heap_end;                ///< end of the user space heap
+  ssize_t num_sbrk;                 ///< number of times ds_sbrk() was called with a non-zero
+                                    ///< argument
+  ssize_t num_trim;                 ///< number of times ds_sbrk() shrunk the heap
+  ssize_t num_decommit;             ///< number of pages released by ds_decommit()
+  void    *prot_brk;                ///< page-aligned end of the read/write area (guard page)
+  size_t  pagesize;                 ///< granularity of guard pages, protection, and decommits
+  PageMode pagemode;                ///< page mode in effect (after fallbacks)
+  void    *prefault_end;            ///< end of the pages prefaulted past brk
+  ssize_t num_prefault;             ///< number of pages prefaulted by the helper thread
+} DataSeg;
+
+static DataSeg ds_seg[DS_MAXSEG];   ///< data segments (unused if start == NULL)
 static int  PAGESIZE  = 0;          ///< (system) page size
 static int  ds_initialized = 0;     ///< initialized flag (yes: 1, otherwise 0)
 static int  ds_loglevel    = 0;     ///< log level (0: off; 1: info; 2: verbose)
-static int  ds_domprotect  = 1;     ///< mprotect() heap areas (0: off, 1: on)
-static ssize_t ds_num_sbrk = 0;     ///< number of times ds_sbrk() was called with a non-zero 
-                                    ///< argument
+static ProtectMode ds_mprotect = pm_Incremental; ///< protection of the heap area past brk
+static PageMode ds_pagemode = pg_Default; ///< page mode of new data segments
+static int  ds_populate    = 0;     ///< prefault segments and regions (0: on demand, 1: prefault)
+static ssize_t ds_nmap     = 0;     ///< number of ds_map_region() calls
+static size_t ds_mapped    = 0;     ///< bytes in mapped regions
+static size_t ds_peak_mapped = 0;   ///< peak of ds_mapped
+static size_t ds_prefault  = 0;     ///< prefault distance past brk (0: no helper thread)
+static int  ds_pf_pending  = 0;     ///< a brk pointer grew since the helper's last pass
+static int  ds_pf_running  = 0;     ///< helper thread started (1) or not (0)
+static pthread_t ds_pf_thread;      ///< prefault helper thread
+static pthread_mutex_t ds_pf_lock = PTHREAD_MUTEX_INITIALIZER; ///< protects the helper's state
+static pthread_cond_t  ds_pf_wakeup = PTHREAD_COND_INITIALIZER; ///< wakes the helper thread
+/// @brief segment locks; serialize brk and protection changes with the helper thread
+static pthread_mutex_t ds_lock[DS_MAXSEG] = { [0 ... DS_MAXSEG-1] = PTHREAD_MUTEX_INITIALIZER };
 
 
 /// @brief print a log message if level <= ds_loglevel. The variadic argument is a printf format
@@ -122,112 +211,392 @@ static void ds_log(int level, ...)
   #define LOG(level, ...)
 #endif
 
-void ds_allocate(size_t max_heap_size)
+/// @brief mprotect() @a len bytes at @a addr; terminates on error
+static void ds_protect_range(void *addr, size_t len, int prot)
 {
-  LOG(1, "ds_allocate(%lx)", max_heap_size);
+  if (len == 0) return;
+
+  LOG(2, "  setting memory protection: %s from %p to %p",
+      prot == PROT_NONE ? "NO ACCESS" : "READ/WRITE", addr, addr + len);
+
+  if (mprotect(addr, len, prot) != 0) {
+    fprintf(stderr, "ERROR: cannot set memory protection flags in %s: %s.\n",
+        __func__, strerror(errno));
+    exit(EXIT_FAILURE);
+  }
+}
+
+/// @brief return @a addr rounded up to the next page boundary of segment @a ds
+static inline void* page_ceil(DataSeg *ds, void *addr)
+{
+  return (void*)(((unsigned long)addr + ds->pagesize-1) / ds->pagesize * ds->pagesize);
+}
+
+/// @brief return @a addr rounded down to a page boundary of segment @a ds
+static inline void* page_floor(DataSeg *ds, void *addr)
+{
+  return (void*)(((unsigned long)addr) / ds->pagesize * ds->pagesize);
+}
+
+/// @brief set up the protection of the heap area of @a ds for the current mode from scratch
+static void ds_protect(DataSeg *ds)
+{
+  void *brk = page_ceil(ds, ds->heap_brk);
+  int past_brk = (ds_mprotect == pm_Full) || (ds_mprotect == pm_Incremental) ?
+                 PROT_NONE : PROT_READ|PROT_WRITE;
+
+  ds_protect_range(ds->heap_start, brk - ds->heap_start, PROT_READ|PROT_WRITE);
+  ds_protect_range(brk, ds->heap_end - brk, past_brk);
+  if ((ds_mprotect == pm_Guard) && (brk < ds->heap_end)) ds_protect_range(brk, ds->pagesize, PROT_NONE);
+
+  ds->prot_brk = brk;
+}
+
+/// @brief update the protection of the heap area of @a ds after its brk pointer moved
+static void ds_update_protection(DataSeg *ds)
+{
+  void *brk = page_ceil(ds, ds->heap_brk);
+  void *old = ds->prot_brk;
+
+  switch (ds_mprotect) {
+    case pm_Full:
+      // permissions are set per page of the segment (a huge page with pg_THP/pg_HugeTLB), so the
+      // page containing brk stays accessible. Both ranges end on a page boundary of the segment;
+      // otherwise mprotect() splits the huge page (THP) or fails (hugetlbfs).
+      ds_protect_range(brk, ds->end - brk, PROT_NONE);
+      ds_protect_range(ds->heap_start, brk - ds->heap_start, PROT_READ|PROT_WRITE);
+      break;
+
+    case pm_Incremental:
+      if (brk > old) ds_protect_range(old, brk - old, PROT_READ|PROT_WRITE);
+      else ds_protect_range(brk, old - brk, PROT_NONE);
+      break;
+
+    case pm_Guard:
+      if (brk == old) break;
+      if (brk < ds->heap_end) ds_protect_range(brk, ds->pagesize, PROT_NONE);
+      if (old < ds->heap_end) ds_protect_range(old, ds->pagesize, PROT_READ|PROT_WRITE);
+      break;
+
+    default:
+      break;
+  }
+
+  ds->prot_brk = brk;
+}
+
+/// @brief fault in the pages [@a from, @a to) past the brk pointer of @a ds. The pages end up with
+///        the protection of the current mode. Called with the segment lock held.
+static void ds_populate_range(DataSeg *ds, void *from, void *to)
+{
+  // pages past brk are PROT_NONE except in pm_Off and, apart from the guard page, in pm_Guard
+  void *none = from, *none_end = to;
+  if (ds_mprotect == pm_Off) none_end = none;
+  else if (ds_mprotect == pm_Guard) {
+    none = ds->prot_brk > from ? ds->prot_brk : from;
+    none_end = ds->prot_brk + ds->pagesize < to ? ds->prot_brk + ds->pagesize : to;
+    if (none_end < none) none_end = none;
+  }
+
+  ds_protect_range(none, none_end - none, PROT_READ|PROT_WRITE);
+
+  int populated = -1;
+#ifdef MADV_POPULATE_WRITE
+  populated = madvise(from, to - from, MADV_POPULATE_WRITE);
+#endif
+  if (populated != 0) {
+    // older kernels: touch every page. The pages are past brk and contain no data.
+    for (char *p = from; p < (char*)to; p += PAGESIZE) *(volatile char*)p = 0;
+  }
+
+  ds_protect_range(none, none_end - none, PROT_NONE);
+}
+
+/// @brief prefault the next chunk of pages within @a distance bytes past the brk pointer of
+///        segment @a seg
+/// @retval 1 if pages were prefaulted
+/// @retval 0 if there was nothing left to do
+static int ds_prefault_seg(int seg, size_t distance)
+{
+  DataSeg *ds = &ds_seg[seg];
+  int busy = 0;
+
+  pthread_mutex_lock(&ds_lock[seg]);
+  if (ds->start != NULL) {
+    void *brk = page_ceil(ds, ds->heap_brk);
+    void *from = ds->prefault_end > brk ? ds->prefault_end : brk;
+    void *to = distance < (size_t)(ds->heap_end - brk) ? page_ceil(ds, brk + distance) : ds->heap_end;
+    size_t chunk = PREFAULT_CHUNK > ds->pagesize ? PREFAULT_CHUNK : ds->pagesize;
+
+    if (to > from + chunk) to = from + chunk;
+    if (from < to) {
+      ds_populate_range(ds, from, to);
+      ds->prefault_end = to;
+      ds->num_prefault += (to - from) / PAGESIZE;
+      busy = 1;
+    }
+  }
+  pthread_mutex_unlock(&ds_lock[seg]);
+
+  return busy;
+}
+
+/// @brief prefault helper thread. Runs until ds_setprefault(0) is called.
+static void* ds_prefaulter(void *arg)
+{
+  (void)arg;
+
+  // prefaulting is speculative; only use otherwise idle CPU time
+  struct sched_param param = { .sched_priority = 0 };
+  pthread_setschedparam(pthread_self(), SCHED_IDLE, &param);
 
-  if (ds_start != NULL) ds_release();
+  pthread_mutex_lock(&ds_pf_lock);
+  while (ds_prefault > 0) {
+    size_t distance = ds_prefault;
+    ds_pf_pending = 0;
+    pthread_mutex_unlock(&ds_pf_lock);
 
+    int busy = 0;
+    for (int seg = 0; seg < DS_MAXSEG; seg++) busy |= ds_prefault_seg(seg, distance);
+
+    pthread_mutex_lock(&ds_pf_lock);
+    if (!busy && !ds_pf_pending && (ds_prefault > 0)) pthread_cond_wait(&ds_pf_wakeup, &ds_pf_lock);
+  }
+  pthread_mutex_unlock(&ds_pf_lock);
+
+  return NULL;
+}
+
+/// @brief account for @a add bytes mapped and @a sub bytes unmapped in regions
+static void ds_account_region(size_t add, size_t sub)
+{
+  size_t mapped = __atomic_add_fetch(&ds_mapped, add - sub, __ATOMIC_RELAXED);
+  size_t peak = __atomic_load_n(&ds_peak_mapped, __ATOMIC_RELAXED);
+  while ((mapped > peak) && !__atomic_compare_exchange_n(&ds_peak_mapped, &peak, mapped, 1,
+                                                         __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+}
+
+/// @brief map a data segment of @a max_heap_size bytes into @a ds
+/// @retval 0 on success
+/// @retval -1 if the memory cannot be mapped
+static int ds_map(DataSeg *ds, size_t max_heap_size)
+{
   PAGESIZE = getpagesize();
-  size_t ds_size = max_heap_size + 2*PAGESIZE;
 
-  // allocate memory for the data segment
+  // huge pages: guard pages, protection, and decommits operate on whole huge pages
+  PageMode mode = ds_pagemode;
+  size_t pagesize = (mode == pg_THP) || (mode == pg_HugeTLB) ? HUGE_PAGESIZE : PAGESIZE;
+  size_t ds_size = (max_heap_size + pagesize-1) / pagesize * pagesize + 2*pagesize;
+
+  // allocate memory for the data segment. MAP_POPULATE has no effect on PROT_NONE mappings, so
+  // the segment is mapped read/write when prefaulting and protected by ds_protect() below.
   LOG(2, "  allocating %lx bytes of memory", ds_size);
-  ds_start = mmap(NULL, ds_size, PROT_NONE, MAP_PRIVATE|MAP_ANONYMOUS|MAP_POPULATE, -1, 0);
-  if (ds_start == (void*)-1) {
-    fprintf(stderr, "ERROR: cannot map memory in %s: %s.\n",
-                    __func__, strerror(errno));
-    exit(EXIT_FAILURE);
+  int prot = ds_populate ? PROT_READ|PROT_WRITE : PROT_NONE;
+  int flags = MAP_PRIVATE|MAP_ANONYMOUS|(ds_populate ? MAP_POPULATE : MAP_NORESERVE);
+  void *start = (void*)-1;
+
+  if (mode == pg_HugeTLB) {
+    // reserve the pages: with MAP_NORESERVE an exhausted pool only shows as SIGBUS on access
+    start = mmap(NULL, ds_size, prot, (flags & ~MAP_NORESERVE)|MAP_HUGETLB, -1, 0);
+    if (start == (void*)-1) {
+      LOG(1, "  cannot map huge pages (%s); falling back to transparent huge pages", strerror(errno));
+      mode = pg_THP;
+    }
+  }
+
+  if (start == (void*)-1) {
+    // over-allocate to align the segment to its page size, then unmap the excess
+    size_t excess = pagesize - PAGESIZE;
+    void *map = mmap(NULL, ds_size + excess, prot, flags, -1, 0);
+    if (map == (void*)-1) return -1;
+
+    start = (void*)(((unsigned long)map + pagesize-1) / pagesize * pagesize);
+    if (start > map) munmap(map, start - map);
+    if (map + excess > start) munmap(start + ds_size, map + excess - start);
+
+    if (mode != pg_Default) madvise(start, ds_size, mode == pg_Small ? MADV_NOHUGEPAGE : MADV_HUGEPAGE);
   }
 
   // try to lock the memory in RAM. Print only a warning if we don't succeed.
   /* don't do this for now. Requires changing resource limits in VM.
   LOG(2, "  locking memory in DRAM...", ds_size);
-  if (mlock(ds_start, ds_size) < 0) {
+  if (mlock(start, ds_size) < 0) {
     fprintf(stderr, "WARNING: cannot lock memory in %s: %s.\n",
                     __func__, strerror(errno));
   }
   */
 
   // initalize pointers
-  ds_end         = ds_start + ds_size;
-  ds_heap_start  = ds_start + PAGESIZE;
-  ds_heap_brk    = ds_heap_start;
-  ds_heap_end    = ds_end - PAGESIZE;
+  pthread_mutex_lock(&ds_lock[ds - ds_seg]);
+  ds->start      = start;
+  ds->end        = start + ds_size;
+  ds->heap_start = start + pagesize;
+  ds->heap_brk   = ds->heap_start;
+  ds->heap_end   = ds->end - pagesize;
+  ds->pagesize   = pagesize;
+  ds->pagemode   = mode;
+  ds->num_sbrk   = 0;
+  ds->num_trim   = 0;
+  ds->num_decommit = 0;
+  ds->prefault_end = ds->heap_start;
+  ds->num_prefault = 0;
   ds_initialized = 1;
-  ds_num_sbrk    = 0;
+
+  ds_protect(ds);
+  if (ds_populate) {
+    ds_protect_range(ds->start, pagesize, PROT_NONE);
+    ds_protect_range(ds->heap_end, pagesize, PROT_NONE);
+  }
+  pthread_mutex_unlock(&ds_lock[ds - ds_seg]);
 
   LOG(2, "  ds_start:           %p\n"
          "  ds_heap_start:      %p\n"
          "  ds_heap_brk:        %p\n"
          "  ds_heap_end:        %p\n"
          "  ds_end:             %p\n"
-         "  PAGESIZE:           %d\n",
-         ds_start, ds_heap_start, ds_heap_brk, ds_heap_end, ds_end, PAGESIZE);
+         "  page size:          %lu\n",
+         ds->start, ds->heap_start, ds->heap_brk, ds->heap_end, ds->end, pagesize);
+
+  return 0;
 }
 
+void ds_allocate(size_t max_heap_size)
+{
+  LOG(1, "ds_allocate(%lx)", max_heap_size);
+
+  ds_release();
 
-void ds_release(void)
+  if (ds_map(&ds_seg[0], max_heap_size) != 0) {
+    fprintf(stderr, "ERROR: cannot map memory in %s: %s.\n",
+                    __func__, strerror(errno));
+    exit(EXIT_FAILURE);
+  }
+}
+
+
+int ds_allocate_seg(size_t max_heap_size)
 {
-  LOG(1, "ds_release()");
+  LOG(1, "ds_allocate_seg(%lx)", max_heap_size);
+
+  for (int seg = 1; seg < DS_MAXSEG; seg++) {
+    if (ds_seg[seg].start == NULL) return ds_map(&ds_seg[seg], max_heap_size) == 0 ? seg : -1;
+  }
+
+  errno = ENOMEM;
+  return -1;
+}
+
 
-  if (ds_start != NULL) {
+void ds_release_seg(int seg)
+{
+  LOG(1, "ds_release_seg(%d)", seg);
+  assert((seg >= 0) && (seg < DS_MAXSEG));
+
+  DataSeg *ds = &ds_seg[seg];
+
+  pthread_mutex_lock(&ds_lock[seg]);
+  if (ds->start != NULL) {
     // unlock & release memory. Ignore error message here.
-    //munlock(ds_start, ds_end-ds_start);
-    munmap(ds_start, ds_end-ds_start);
+    //munlock(ds->start, ds->end-ds->start);
+    munmap(ds->start, ds->end-ds->start);
   }
 
-  ds_start = ds_end = ds_heap_start = ds_heap_brk = ds_heap_end = NULL;
+  memset(ds, 0, sizeof(*ds));
+  pthread_mutex_unlock(&ds_lock[seg]);
+}
+
+
+void ds_release(void)
+{
+  LOG(1, "ds_release()");
+
+  for (int seg = 0; seg < DS_MAXSEG; seg++) ds_release_seg(seg);
+
+  // regions outlive the data segments; restart their statistics
+  ds_nmap = 0;
+  ds_peak_mapped = ds_mapped;
+
   PAGESIZE = 0;
   ds_initialized = 0;
 }
 
 
-void* ds_sbrk(intptr_t increment)
+void* ds_sbrk_seg(int seg, intptr_t increment)
 {
-  LOG(1, "ds_sbrk(%c0x%lx)", increment < 0 ? '-' : '+', labs(increment));
-  assert(ds_initialized);
+  LOG(1, "ds_sbrk_seg(%d, %c0x%lx)", seg, increment < 0 ? '-' : '+', labs(increment));
+  assert(ds_initialized && (seg >= 0) && (seg < DS_MAXSEG) && (ds_seg[seg].start != NULL));
+
+  DataSeg *ds = &ds_seg[seg];
 
-  void *old_heap_brk = ds_heap_brk;
+  pthread_mutex_lock(&ds_lock[seg]);
+  void *old_heap_brk = ds->heap_brk;
 
   if (increment != 0) {
-    ds_heap_brk += increment;
-    ds_num_sbrk++;
-
-    if ((ds_heap_start <= ds_heap_brk) && (ds_heap_brk < ds_heap_end)) {
-      if (ds_domprotect) {
-        // adjust memory access permissions
-        // since we are not forcing alignment of brk at PAGESIZE, we need to mark the invalid part
-        // before allowing access to the permissible area because permissions are set on a page-level
-        // basis
-        LOG(2, "  setting memory protection:\n"
-            "    READ/WRITE from %p to %p\n"
-            "    NO ACCESS  from %p to %p\n",
-            ds_heap_start, ds_heap_brk, ds_heap_brk, ds_end);
-
-        void *aligned_brk = (void*)(((unsigned long)ds_heap_brk) / PAGESIZE * PAGESIZE); // round down
-
-        if ((mprotect(aligned_brk, ds_end-aligned_brk, PROT_NONE) != 0) ||
-            (mprotect(ds_heap_start, ds_heap_brk-ds_heap_start, PROT_READ|PROT_WRITE) != 0))
-        {
-          fprintf(stderr, "ERROR: cannot set memory protection flags in %s: %s.\n", 
-              __func__, strerror(errno));
-          exit(EXIT_FAILURE);
-        }
+    ds->heap_brk += increment;
+    ds->num_sbrk++;
+    if (increment < 0) ds->num_trim++;
+
+    if ((ds->heap_start <= ds->heap_brk) && (ds->heap_brk < ds->heap_end)) {
+      // adjust memory access permissions
+      ds_update_protection(ds);
+
+      // give the pages above the new brk back to the system
+      if (increment < 0) {
+        void *from = page_ceil(ds, ds->heap_brk), *to = page_ceil(ds, old_heap_brk);
+        if (to > from) madvise(from, to - from, MADV_DONTNEED);
+        if (ds->prefault_end > from) ds->prefault_end = from;
       }
     } else {
       // ignore increment and signal an error if we ended up outside the simulated data segment
       LOG(1, "  invalid increment (ended up outside valid data segment)");
       errno = ENOMEM;
-      ds_heap_brk = old_heap_brk;
+      ds->heap_brk = old_heap_brk;
       old_heap_brk = (void*)-1;
     }
   }
+  pthread_mutex_unlock(&ds_lock[seg]);
+
+  // let the helper thread prefault the pages past the new brk
+  if ((increment > 0) && (old_heap_brk != (void*)-1) && __atomic_load_n(&ds_prefault, __ATOMIC_RELAXED)) {
+    pthread_mutex_lock(&ds_pf_lock);
+    ds_pf_pending = 1;
+    pthread_cond_signal(&ds_pf_wakeup);
+    pthread_mutex_unlock(&ds_pf_lock);
+  }
 
   return old_heap_brk;
 }
 
 
+int ds_decommit(void *addr, size_t len)
+{
+  LOG(1, "ds_decommit(%p, %lx)", addr, len);
+
+  for (int seg = 0; seg < DS_MAXSEG; seg++) {
+    DataSeg *ds = &ds_seg[seg];
+    if ((ds->start == NULL) || (addr < ds->heap_start) || (addr + len > ds->heap_brk)) continue;
+
+    void *from = page_ceil(ds, addr);
+    void *to = page_floor(ds, addr + len);
+    if (to <= from) return 0;
+
+    if (madvise(from, to - from, MADV_DONTNEED) != 0) return -1;
+    ds->num_decommit += (to - from) / PAGESIZE;
+
+    return 0;
+  }
+
+  errno = EINVAL;
+  return -1;
+}
+
+
+void* ds_sbrk(intptr_t increment)
+{
+  return ds_sbrk_seg(0, increment);
+}
+
+
 int ds_getpagesize(void)
 {
   assert(ds_initialized);
@@ -236,17 +605,140 @@ int ds_getpagesize(void)
 }
 
 
+void ds_heap_stat_seg(int seg, void **start, void **brk, void **end)
+{
+  assert((seg >= 0) && (seg < DS_MAXSEG));
+
+  if (start) *start = ds_seg[seg].heap_start;
+  if (brk)   *brk   = ds_seg[seg].heap_brk;
+  if (end)   *end   = ds_seg[seg].heap_end;
+}
+
+
 void ds_heap_stat(void **start, void **brk, void **end)
 {
-  if (start) *start = ds_heap_start;
-  if (brk)   *brk   = ds_heap_brk;
-  if (end)   *end   = ds_heap_end;
+  ds_heap_stat_seg(0, start, brk, end);
+}
+
+
+void* ds_map_region(size_t size)
+{
+  LOG(1, "ds_map_region(%lx)", size);
+
+  size_t pagesize = getpagesize();
+  size = (size + pagesize-1) / pagesize * pagesize;
+
+  void *start = mmap(NULL, size, PROT_READ|PROT_WRITE,
+                     MAP_PRIVATE|MAP_ANONYMOUS|(ds_populate ? MAP_POPULATE : 0), -1, 0);
+  if (start == (void*)-1) return NULL;
+
+  __atomic_add_fetch(&ds_nmap, 1, __ATOMIC_RELAXED);
+  ds_account_region(size, 0);
+
+  return start;
+}
+
+
+void* ds_remap_region(void *start, size_t old_size, size_t new_size)
+{
+  LOG(1, "ds_remap_region(%p, %lx, %lx)", start, old_size, new_size);
+
+  size_t pagesize = getpagesize();
+  old_size = (old_size + pagesize-1) / pagesize * pagesize;
+  new_size = (new_size + pagesize-1) / pagesize * pagesize;
+
+  // the page tables move along with the region; no data is copied
+  void *region = mremap(start, old_size, new_size, MREMAP_MAYMOVE);
+  if (region == (void*)-1) return NULL;
+
+#ifdef MADV_POPULATE_WRITE
+  if (ds_populate && (new_size > old_size)) {
+    madvise(region + old_size, new_size - old_size, MADV_POPULATE_WRITE);
+  }
+#endif
+
+  ds_account_region(new_size, old_size);
+
+  return region;
+}
+
+
+void ds_unmap_region(void *start, size_t size)
+{
+  LOG(1, "ds_unmap_region(%p, %lx)", start, size);
+
+  size_t pagesize = getpagesize();
+  size = (size + pagesize-1) / pagesize * pagesize;
+
+  munmap(start, size);
+  ds_account_region(0, size);
+}
+
+
+void ds_region_stat(ssize_t *nmap, size_t *mapped, size_t *peak)
+{
+  if (nmap)   *nmap   = __atomic_load_n(&ds_nmap, __ATOMIC_RELAXED);
+  if (mapped) *mapped = __atomic_load_n(&ds_mapped, __ATOMIC_RELAXED);
+  if (peak)   *peak   = __atomic_load_n(&ds_peak_mapped, __ATOMIC_RELAXED);
+}
+
+
+ssize_t ds_getnsbrk_seg(int seg)
+{
+  assert((seg >= 0) && (seg < DS_MAXSEG));
+
+  return ds_seg[seg].num_sbrk;
 }
 
 
 ssize_t ds_getnsbrk(void)
 {
-  return ds_num_sbrk;
+  ssize_t nsbrk = 0;
+
+  for (int seg = 0; seg < DS_MAXSEG; seg++) nsbrk += ds_seg[seg].num_sbrk;
+
+  return nsbrk;
+}
+
+ssize_t ds_getntrim_seg(int seg)
+{
+  assert((seg >= 0) && (seg < DS_MAXSEG));
+
+  return ds_seg[seg].num_trim;
+}
+
+
+ssize_t ds_getntrim(void)
+{
+  ssize_t ntrim = 0;
+
+  for (int seg = 0; seg < DS_MAXSEG; seg++) ntrim += ds_seg[seg].num_trim;
+
+  return ntrim;
+}
+
+
+ssize_t ds_getndecommit(void)
+{
+  ssize_t npages = 0;
+
+  for (int seg = 0; seg < DS_MAXSEG; seg++) npages += ds_seg[seg].num_decommit;
+
+  return npages;
+}
+
+
+ssize_t ds_getnprefault(void)
+{
+  ssize_t npages = 0;
+
+  for (int seg = 0; seg < DS_MAXSEG; seg++) {
+    pthread_mutex_lock(&ds_lock[seg]);
+    npages += ds_seg[seg].num_prefault;
+    pthread_mutex_unlock(&ds_lock[seg]);
+  }
+
+  return npages;
 }
 
 void ds_setloglevel(int level)
@@ -255,9 +747,61 @@ void ds_setloglevel(int level)
 }
 
 
-void ds_setmprotect(int active)
+void ds_setpagemode(int mode)
 {
-  ds_domprotect = (active > 0);
+  ds_pagemode = (mode >= pg_Default) && (mode <= pg_HugeTLB) ? mode : pg_Default;
+}
+
+
+int ds_getpagemode(void)
+{
+  return ds_seg[0].start != NULL ? (int)ds_seg[0].pagemode : (int)ds_pagemode;
+}
+
+
+void ds_setpopulate(int active)
+{
+  ds_populate = (active > 0);
+}
+
+
+void ds_setmprotect(int mode)
+{
+  if ((mode < pm_Off) || (mode > pm_Guard)) mode = pm_Incremental;
+  if (mode == (int)ds_mprotect) return;
+
+  ds_mprotect = mode;
+
+  // re-establish the protection layout of existing segments
+  for (int seg = 0; seg < DS_MAXSEG; seg++) {
+    pthread_mutex_lock(&ds_lock[seg]);
+    if (ds_seg[seg].start != NULL) ds_protect(&ds_seg[seg]);
+    pthread_mutex_unlock(&ds_lock[seg]);
+  }
+}
+
+
+void ds_setprefault(size_t distance)
+{
+  pthread_mutex_lock(&ds_pf_lock);
+  __atomic_store_n(&ds_prefault, distance, __ATOMIC_RELAXED);
+  ds_pf_pending = 1;
+  pthread_cond_signal(&ds_pf_wakeup);
+  pthread_mutex_unlock(&ds_pf_lock);
+
+  if ((distance > 0) && !ds_pf_running) {
+    int error = pthread_create(&ds_pf_thread, NULL, ds_prefaulter, NULL);
+    if (error != 0) {
+      fprintf(stderr, "WARNING: cannot start prefault thread in %s: %s.\n",
+                      __func__, strerror(error));
+      __atomic_store_n(&ds_prefault, 0, __ATOMIC_RELAXED);
+      return;
+    }
+    ds_pf_running = 1;
+  } else if ((distance == 0) && ds_pf_running) {
+    pthread_join(ds_pf_thread, NULL);
+    ds_pf_running = 0;
+  }
 }
 
 
@@ -36,14 +36,42 @@
 
 #include <unistd.h>
 
-/// @brief initialize simulated data segment. Allocates & locks memory pages in RAM to minimize
-///        performance variance.
+#define DS_MAXSEG 64                    ///< maximal number of data segments (ids 0 ... DS_MAXSEG-1)
+
+/// @brief protection of the heap area past the brk pointer (see ds_setmprotect())
+typedef enum {
+  pm_Off         = 0,             ///< heap area read/write, no mprotect() calls
+  pm_Full        = 1,             ///< re-protect the whole segment on every sbrk()
+  pm_Incremental = 2,             ///< only re-protect the pages brk moved across (default)
+  pm_Guard       = 3,             ///< one PROT_NONE guard page past brk
+} ProtectMode;
+
+/// @brief page size of the data segment (see ds_setpagemode())
+typedef enum {
+  pg_Default     = 0,             ///< system default
+  pg_Small       = 1,             ///< base pages only (no transparent huge pages)
+  pg_THP         = 2,             ///< 2 MiB transparent huge pages
+  pg_HugeTLB     = 3,             ///< 2 MiB pages from hugetlbfs, falls back to pg_THP
+} PageMode;
+
+/// @brief initialize simulated data segment. Reserves address space; pages are faulted in on
+///        demand unless ds_setpopulate(1) was called.
 /// @param max_heap_size maximum possible size of heap data segment
 void ds_allocate(size_t max_heap_size);
 
-/// @brief release simulated data segment
+/// @brief release all simulated data segments
 void ds_release(void);
 
+/// @brief allocate an additional, independent data segment (see ds_allocate())
+/// @param max_heap_size maximum possible size of heap data segment
+/// @retval int id of new segment (> 0)
+/// @retval -1 on error
+int ds_allocate_seg(size_t max_heap_size);
+
+/// @brief release data segment @a seg
+/// @param seg segment id
+void ds_release_seg(int seg);
+
 /// @brief sbrk() implementation on our simulated data segment. Operates exactly as the kernel's
 ///        sbrk() function (see man sbrk)
 /// @param increment offset by which to increase/decrease current brk.
@@ -51,6 +79,22 @@ void ds_release(void);
 /// @retval (void*)-1 on error. errno is set to ENOMEM
 void* ds_sbrk(intptr_t increment);
 
+/// @brief sbrk() on data segment @a seg (see ds_sbrk())
+/// @param seg segment id
+/// @param increment offset by which to increase/decrease current brk.
+/// @retval old brk on success.
+/// @retval (void*)-1 on error. errno is set to ENOMEM
+void* ds_sbrk_seg(int seg, intptr_t increment);
+
+/// @brief release the physical memory of the whole pages within [@a addr, @a addr + @a len). The
+///        range must lie between the start of a data segment's heap and its brk pointer; it stays
+///        accessible and reads as zero when touched again.
+/// @param addr start of range (need not be page-aligned)
+/// @param len length of range in bytes
+/// @retval 0 on success
+/// @retval -1 on error. errno is set to EINVAL if the range is not within a heap
+int ds_decommit(void *addr, size_t len);
+
 /// @brief retrieve pagesize of data segment
 /// @retval page size
 /// @retval 0 if not data segment not initialized)
@@ -63,16 +107,87 @@ int ds_getpagesize(void);
 /// @param[out] nsbrk number of times sbrk() was called with a non-zero argument
 void ds_heap_stat(void **start, void **brk, void **end);
 
-/// @brief retrieve the number of sbrk() was called with a non-zero argument
+/// @brief retrieve statistics about data segment @a seg (see ds_heap_stat())
+/// @param seg segment id
+void ds_heap_stat_seg(int seg, void **start, void **brk, void **end);
+
+/// @brief retrieve the number of sbrk() was called with a non-zero argument (all segments)
 /// @retval ssize_t number of sbrk() calls
 ssize_t ds_getnsbrk(void);
 
+/// @brief retrieve the number of sbrk() was called with a non-zero argument on segment @a seg
+/// @param seg segment id
+/// @retval ssize_t number of sbrk() calls
+ssize_t ds_getnsbrk_seg(int seg);
+
+/// @brief retrieve the number of times sbrk() was called with a negative argument (all segments)
+/// @retval ssize_t number of heap trims
+ssize_t ds_getntrim(void);
+
+/// @brief retrieve the number of times sbrk() was called with a negative argument on segment @a seg
+/// @param seg segment id
+/// @retval ssize_t number of heap trims
+ssize_t ds_getntrim_seg(int seg);
+
+/// @brief retrieve the number of pages released by ds_decommit() (all segments)
+/// @retval ssize_t number of pages
+ssize_t ds_getndecommit(void);
+
+/// @brief retrieve the number of pages prefaulted by the helper thread (all segments)
+/// @retval ssize_t number of pages
+ssize_t ds_getnprefault(void);
+
+/// @brief map a region of at least @a size bytes outside of all data segments. The region is
+///        page-aligned and page-granular.
+/// @param size size of region in bytes
+/// @retval void* start of region
+/// @retval NULL if the region cannot be mapped
+void* ds_map_region(size_t size);
+
+/// @brief resize a region returned by ds_map_region(). The contents are preserved up to the
+///        smaller of the two sizes; the region may move, but its pages are remapped, not copied.
+/// @param start start of region
+/// @param old_size size of region in bytes as passed to ds_map_region()
+/// @param new_size new size of region in bytes
+/// @retval void* start of resized region
+/// @retval NULL if the region cannot be resized (it remains valid at @a start)
+void* ds_remap_region(void *start, size_t old_size, size_t new_size);
+
+/// @brief unmap a region returned by ds_map_region()
+/// @param start start of region
+/// @param size size of region in bytes as passed to ds_map_region()
+void ds_unmap_region(void *start, size_t size);
+
+/// @brief retrieve statistics about mapped regions
+/// @param[out] nmap   number of times ds_map_region() was called
+/// @param[out] mapped bytes currently mapped in regions
+/// @param[out] peak   peak number of bytes mapped in regions
+void ds_region_stat(ssize_t *nmap, size_t *mapped, size_t *peak);
+
 /// @brief set log level
 /// @brief level log level (0: no logging, 1: info; 2: verbose)
 void ds_setloglevel(int level);
 
-/// @brief turn mprotect() on/off
-/// @brief active (1: mprotect() activated, 0: mprotect() not executed)
-void ds_setmprotect(int active);
+/// @brief select the page size of data segments created from now on
+/// @param mode page mode (PageMode; invalid values select pg_Default)
+void ds_setpagemode(int mode);
+
+/// @brief retrieve the page mode in effect for data segment 0 (after fallbacks), or the mode
+///        selected for new segments if there is none
+/// @retval int page mode (PageMode)
+int ds_getpagemode(void);
+
+/// @brief turn prefaulting of new data segments and regions on/off
+/// @param active (1: prefault all pages when mapping, 0: fault pages in on first access)
+void ds_setpopulate(int active);
+
+/// @brief select how the heap area past brk is protected. Applies to existing segments as well.
+/// @param mode protection mode (ProtectMode; invalid values select pm_Incremental)
+void ds_setmprotect(int mode);
+
+/// @brief start/stop the prefault helper thread. The helper faults in the pages up to @a distance
+///        bytes past the brk pointer of every data segment while the heap grows.
+/// @param distance prefault distance in bytes (0: stop the helper thread)
+void ds_setprefault(size_t distance);
 
 #endif // __DATSEG_H__
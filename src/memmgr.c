@@ -15,7 +15,7 @@
 // Heap organization:
 // ------------------
 // The data segment for the heap is provided by the dataseg module. A 'word' in the heap is
-// eight bytes.
+// eight bytes (four bytes in the compact layout, see below).
 //
 // Implicit free list:
 // -------------------
@@ -62,20 +62,230 @@
 //                       |                                         |
 //               32-byte aligned                           32-byte aligned
 //
-// - allocation policy: best fit
+// - allocation policy: best fit (see Placement)
+// - block splitting: always at 32-byte boundaries
+// - immediate coalescing upon free
+//
+// Segregated free lists:
+// ----------------------
+// - block layout identical to the explicit free list
+// - free blocks are kept in SEG_NUM explicit LIFO lists, one per size class
+//     class 0 ... SEG_EXACT-1:   exact sizes BS, 2*BS, ..., SEG_LIMIT
+//     class SEG_EXACT ... :      power-of-two ranges (SEG_LIMIT, 2*SEG_LIMIT], (2*SEG_LIMIT, ...]
+//                                the last class holds all remaining larger blocks
+// - allocation policy: best fit. All blocks in a class are larger than the blocks of any lower
+//   class, so the best fit is found in the first non-empty class holding a large enough block.
+//   Exact classes are satisfied by their list head, range classes are searched linearly.
+// - block splitting: always at 32-byte boundaries
+// - immediate coalescing upon free
+//
+// Free block tree:
+// ----------------
+// - minimal block size: 32 bytes (header + footer + left + right)
+// - h,f: header/footer of free block
+// - l,r: left/right child in tree
+//
+//               +---+---+---+---------------------------+---+
+//               | h | l | r |                           | f |
+//               +---+---+---+---------------------------+---+
+//
+// - free blocks form a treap (Cartesian tree) ordered by (size, address). The heap priority of a
+//   node is a hash of its address, so no extra word is needed and the expected depth is O(log n).
+// - allocation policy: best fit. The best fit is the lower bound of the requested size.
+// - block splitting: always at 32-byte boundaries
+// - immediate coalescing upon free
+//
+// Two-level segregated fit (TLSF):
+// --------------------------------
+// - block layout identical to the explicit free list
+// - free blocks are kept in TLSF_FL x TLSF_SL explicit LIFO lists. The first level is the
+//   position of the most significant bit of the block size, the second level subdivides each
+//   power-of-two range linearly into TLSF_SL lists.
+// - one bitmap marks non-empty first-level ranges, one bitmap per first level marks non-empty
+//   second-level lists. Both are searched with find-first-set.
+// - allocation policy: good fit. The request is rounded up to the next second-level boundary so
+//   that every block in the selected list fits; malloc and free run in constant time.
 // - block splitting: always at 32-byte boundaries
 // - immediate coalescing upon free
 //
+// Footer elision:
+// ----------------
+// When compiled with -DELIDE_FOOTER, allocated blocks carry no footer. Bit 1 of every header
+// (PREV_ALLOC) records whether the preceeding block is allocated; only free blocks have a footer,
+// which is all coalescing needs to locate the header of a free predecessor. The end sentinel's
+// PREV_ALLOC bit is maintained like that of any other header.
+//
+//               +---+-------------------------+---+---------------------------+---+
+//               | H |       payload           | h |                           | f |
+//               +---+-------------------------+---+---------------------------+---+
+//
+// - payload of allocated block: block size - 8 bytes
+// - free block layout unchanged
+//
+// Compact boundary tags:
+// ----------------------
+// When compiled with -DCOMPACT_TAGS, a word is 32 bits. Headers and footers take four bytes and
+// the free list and tree links are stored as 32-bit offsets from ds_heap_start (0 denotes NULL)
+// instead of raw pointers. The data segment must therefore not exceed 4 GiB.
+//
+//               +-+-+-+-+---------------------------------------+-+
+//               |h|n|p| :                                       |f|
+//               +-+-+-+-+---------------------------------------+-+
+//
+// - minimal block size: 16 bytes (header + footer + 2 links)
+// - block headers are located at 4 mod 16 so that payloads remain 8-byte aligned
+// - block splitting: always at 16-byte boundaries
+// - can be combined with -DELIDE_FOOTER
+//
+// Slabs:
+// ------
+// Independent of the free list policy, requests of up to SLAB_MAX bytes are served from slabs.
+// A slab is a regular allocated block (status ALLOC|SLAB) obtained from the heap whose payload
+// covers a SLAB_SIZE-aligned window. The window starts with a slab descriptor followed by equally
+// sized objects of one size class (multiples of 16 bytes). A bitmap in the descriptor tracks used
+// objects; the objects themselves carry no boundary tags.
+//
+//       SLAB_SIZE aligned                                            SLAB_SIZE aligned
+//               |                                                             |
+//   +---+-------+------------+------+------+------+-----    -----+------+---+
+//   | H |  ...  | descriptor | obj0 | obj1 | obj2 |      ...     | objn | F |
+//   +---+-------+------------+------+------+------+-----    -----+------+---+
+//
+// Payloads of regular blocks are located at 8 mod BS, slab objects at 0 mod 16. mm_free() and
+// mm_realloc() use this and the slab map of the arena to recognize slab objects; the descriptor
+// is found by masking the address with SLAB_SIZE. Slabs with free objects are kept in a list per
+// size class; a slab that becomes empty is returned to the heap unless it is the last slab of
+// its class.
+//
+// Arenas:
+// -------
+// The heap state (data segment, sentinels, free lists, quick lists, slabs, and lock) lives in an
+// Arena. mm_setarenas() selects the number of arenas for the next mm_init(); arena 0 uses the
+// data segment set up by ds_allocate(), every further arena gets its own segment from
+// ds_allocate_seg(). All internal functions operate on the calling thread's 'arena' pointer:
+// mm_malloc() points it at the thread's home arena (assigned round-robin or by CPU), mm_free()
+// and mm_realloc() at the arena whose data segment contains the pointer.
+//
+// Remote frees:
+// -------------
+// With -DMM_THREADS, a thread that frees an object of another arena does not take that arena's
+// lock. It pushes the object onto the arena's lock-free remote-free stack (linked through the
+// first payload word) instead. The owner detaches the whole stack with one atomic exchange and
+// frees (and coalesces) the objects in a batch the next time it holds its lock in mm_malloc().
+// A remote free that brings the number of queued objects to REMOTE_THLD drains the queue itself
+// if the lock is available. mm_setremotefree(0) returns to locking the owner arena on every free.
+//
+// Mapped blocks:
+// --------------
+// Requests of at least mm_mmap_thld bytes (mm_setmmapthld()) bypass the arenas and get a region
+// of their own from ds_map_region(). The region starts with its size, followed by a block header
+// such that the payload has the alignment of a regular block (MMAP_OFS). mm_free() unmaps the
+// region immediately; mapped blocks are recognized by their address (outside of all arenas).
+// mm_realloc() resizes mapped blocks with ds_remap_region(), which moves the pages of the region
+// instead of copying them, and moves blocks between the heap and mapped regions as their size
+// crosses the threshold.
+//
+// Heap growth and trimming:
+// -------------------------
+// The heap grows geometrically: every extension doubles the arena's next extension size (grow),
+// starting at CHUNKSIZE, up to GROW_MAX and at most 1/GROW_DIV of the current heap size. If the
+// last block is free, the heap is only extended by the shortfall (or the growth size, if larger).
+//
+// When a free block at the end of the heap exceeds the size of the arena's last heap extension
+// (trim_keep, at least CHUNKSIZE) by more than SHRINKTHLD, the heap is shrunk with a negative
+// ds_sbrk() so that a free block of trim_keep bytes remains. The gap between the two marks is the
+// hysteresis that keeps an allocation/free pair at the end of the heap from moving the brk
+// pointer back and forth. A trim resets the growth size to CHUNKSIZE.
+//
+// Free blocks of at least mm_decommit_thld bytes (mm_setdecommit()) in the middle of the heap
+// give their physical memory back as well: free_block() passes the pages between the first BS
+// bytes (header and free list/tree links) and the footer to ds_decommit().
+//
+// Zeroed allocation:
+// ------------------
+// Each arena keeps a zero mark: the end of the highest block ever allocated. Memory above it
+// came from ds_sbrk() and has only held the tags and links of free blocks, so mm_calloc() clears
+// a block only below the zero mark, plus the few words that can hold tags. extend_heap() clears
+// the stale tags that merging leaves behind; a trim raises the mark to the old end of the heap.
+// Mapped blocks are fresh from mmap() and are not cleared at all.
+//
+// Reallocation:
+// -------------
+// mm_realloc() resizes heap blocks in place whenever the neighbors allow it: a shrinking block
+// returns its tail to the free list, a growing block merges with a free successor. A block that
+// ends at the heap end (possibly followed by a free last block) grows by extending the heap. If
+// that is not enough, a free predecessor is merged as well (unless the merged block would exceed
+// twice the requested size) and the payload is moved down with a single memmove(). Only if none
+// of this applies is the block allocated anew, copied, and freed.
+//
+// Aligned allocation:
+// -------------------
+// mm_aligned_alloc() and friends serve alignments beyond the natural alignment (MM_ALIGN) from
+// regular allocated blocks whose payload starts ALIGN_HDR_OFS bytes after the header, i.e., at a
+// multiple of BS. Alignments below BS are raised to BS; larger alignments move the header so that
+// the payload lands on the requested boundary. alloc_aligned_block() returns the leading slack to
+// the free list, split() the tail. Like slab objects, aligned payloads are not located at 8 mod
+// BS. The slab map of the arena (one bit per SLAB_SIZE window of the data segment, set while the
+// window holds a slab) tells them apart without reading memory next to the payload, which may
+// be user data.
+//
+//               +---+-------------+------------------------------------------+---+
+//               | H |             | aligned payload                          | F |
+//               +---+-------------+------------------------------------------+---+
+//               ^                 ^
+//               |                 |
+//         header (HDR_OFS)   multiple of the alignment (at least BS)
+//
+// Regions:
+// --------
+// A region (mm_region_create()) bump-allocates objects from chunks obtained with mm_malloc(). The
+// objects carry no tags and cannot be freed individually; mm_region_destroy() frees the chunks.
+// Chunks are linked through their first word, and the first chunk also holds the descriptor.
+// Objects larger than a quarter of the chunk size get a chunk of their own, so that the current
+// chunk keeps serving small objects.
+//
+// Batches:
+// --------
+// mm_malloc_batch() serves n requests under one lock. Regular blocks are carved from a single free
+// block of n times the block size when one is available (one free list search, one removal, one
+// split); otherwise, and for slab objects, the blocks are allocated one by one. mm_free_batch()
+// sorts the pointers by address and merges runs of adjacent allocated blocks into one block that
+// is freed and coalesced once. Batches bypass the thread caches.
+//
+// Placement:
+// ----------
+// The implicit and explicit lists (and the explicit list of quick fit) select the free block
+// through a placement policy (mm_setplacement()). The 'placements' table maps each policy to its
+// search function for either list; mm_init() installs it as get_free_block. For the other free
+// list policies, mm_init() resets the placement to best fit, so their lists stay LIFO:
+// - best fit: scan the whole list for the smallest block that fits (stop at an exact fit)
+// - first fit: take the first block that fits
+// - next fit: first fit, starting where the previous search succeeded. The arena's rover points
+//   to that block. fl_remove() advances the rover of the explicit list to the next list element;
+//   set_tags() moves the rover of the implicit list to the start of a block that swallows it.
+// - good fit: take the first block that exceeds the request by at most mm_goodfit percent; if
+//   there is none, take the best fit
+// - address-ordered: fl_insert() keeps the free list sorted by address instead of inserting at
+//   the head, so the wilderness block (the last block of the heap) is always at the end of the
+//   list and only used when no other block fits. The search is first fit. Insertion is linear in
+//   the length of the list.
+//
 
 #define _GNU_SOURCE
 
 #include <assert.h>
+#include <errno.h>
 #include <error.h>
+#include <sched.h>
+#ifdef MM_THREADS
+  #include <pthread.h>
+#endif
 #include <stdarg.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
 #include <unistd.h>
 
 #include "dataseg.h"
@@ -84,43 +294,64 @@
 
 /// @name global variables
 /// @{
-static void *ds_heap_start = NULL;                     ///< physical start of data segment
-static void *ds_heap_brk   = NULL;                     ///< physical end of data segment
-static void *heap_start    = NULL;                     ///< logical start of heap
-static void *heap_end      = NULL;                     ///< logical end of heap
 static int  PAGESIZE       = 0;                        ///< memory system page size
 static void *(*get_free_block)(size_t) = NULL;         ///< get free block for selected allocation policy
 static size_t CHUNKSIZE    = 1<<16;                    ///< minimal data segment allocation unit
 static size_t SHRINKTHLD   = 1<<14;                    ///< threshold to shrink heap
 static int  mm_initialized = 0;                        ///< initialized flag (yes: 1, otherwise 0)
 static int  mm_loglevel    = 0;                        ///< log level (0: off; 1: info; 2: verbose)
+static size_t mm_mmap_thld = 1<<17;                    ///< smallest mapped request (0: off)
+static size_t mm_decommit_thld = 1<<16;                ///< smallest decommitted free block (0: off)
 
 // Freelist
 static FreelistPolicy freelist_policy  = 0;            ///< free list management policy
 
-
-//
-// TODO: add more global variables as needed
-//
+// Placement
+static PlacementPolicy placement      = pp_BestFit;    ///< placement policy
+static PlacementPolicy placement_next = pp_BestFit;    ///< placement policy for next mm_init()
+static unsigned int    mm_goodfit     = 25;            ///< good fit bound in percent of the request
 /// @}
 
+
 /// @name Macro definitions
 /// @{
 #define MAX(a, b)          ((a) > (b) ? (a) : (b))     ///< MAX function
+#define MIN(a, b)          ((a) < (b) ? (a) : (b))     ///< MIN function
 
-#define TYPE               unsigned long               ///< word type of heap
+#ifdef COMPACT_TAGS
+  #define TYPE             uint32_t                    ///< word type of heap
+#else
+  #define TYPE             unsigned long               ///< word type of heap
+#endif
 #define TYPE_SIZE          sizeof(TYPE)                ///< size of word type
 
 #define ALLOC              1                           ///< block allocated flag
 #define FREE               0                           ///< block free flag
-#define STATUS_MASK        ((TYPE)(0x7))               ///< mask to retrieve flags from header/footer
+#define PREV_ALLOC         2                           ///< previous block allocated (ELIDE_FOOTER)
+#define SLAB               4                           ///< block holds a slab (with ALLOC)
+#define QUICK              8                           ///< block parked on a quick list (with ALLOC)
+#define STATUS_MASK        ((TYPE)(0xf))               ///< mask to retrieve flags from header/footer
 #define SIZE_MASK          (~STATUS_MASK)              ///< mask to retrieve size from header/footer
 
-#define BS                 32                          ///< minimal block size. Must be a power of 2
+#ifdef COMPACT_TAGS
+  #define BS               16                          ///< minimal block size. Must be a power of 2
+  #define HDR_OFS          4                           ///< offset of block headers from BS alignment
+#else
+  #define BS               32                          ///< minimal block size. Must be a power of 2
+  #define HDR_OFS          0                           ///< offset of block headers from BS alignment
+#endif
 #define BS_MASK            (~(BS-1))                   ///< alignment mask
 
-#define WORD(p)            ((TYPE)(p))                 ///< convert pointer to TYPE
-#define PTR(w)             ((void*)(w))                ///< convert TYPE to void*
+#define WORD(p)            ((uintptr_t)(p))            ///< convert pointer to integer
+#define PTR(w)             ((void*)(w))                ///< convert integer to void*
+
+#ifdef COMPACT_TAGS
+  #define LINK(p)          ((TYPE)((p) != NULL ? (void*)(p) - arena->ds_heap_start : 0)) ///< pointer to link
+  #define UNLINK(v)        ((v) != 0 ? arena->ds_heap_start + (v) : NULL) ///< link to pointer
+#else
+  #define LINK(p)          ((TYPE)WORD(p))             ///< convert pointer to link
+  #define UNLINK(v)        (PTR(v))                    ///< convert link to pointer
+#endif
 
 #define PREV_PTR(p)        ((p)-TYPE_SIZE)             ///< get pointer to word preceeding p
 #define NEXT_PTR(p)        ((p)+TYPE_SIZE)             ///< get pointer to word succeeding p
@@ -128,19 +359,186 @@ static FreelistPolicy freelist_policy  = 0;            ///< free list management
 #define FTR2HDR(p)         ((p)-GET_SIZE(p)+TYPE_SIZE) ///< get header for given footer
 
 #define PACK(size,status)  ((size) | (status))         ///< pack size & status into boundary tag
-#define SIZE(v)            (v & SIZE_MASK)             ///< extract size from boundary tag
-#define STATUS(v)          (v & STATUS_MASK)           ///< extract status from boundary tag
+#define SIZE(v)            ((size_t)((v) & SIZE_MASK)) ///< extract size from boundary tag
+#define STATUS(v)          (v & STATUS_MASK & ~PREV_ALLOC) ///< extract status from boundary tag
 
 #define PUT(p, v)          (*(TYPE*)(p) = (TYPE)(v))   ///< write word v to *p
 #define GET(p)             (*(TYPE*)(p))               ///< read word at *p
 #define GET_SIZE(p)        (SIZE(GET(p)))              ///< extract size from header/footer
 #define GET_STATUS(p)      (STATUS(GET(p)))            ///< extract status from header/footer
 
+#ifdef ELIDE_FOOTER
+  #define ALLOC_OVERHEAD   (TYPE_SIZE)                 ///< tag overhead of allocated block
+#else
+  #define ALLOC_OVERHEAD   (2*TYPE_SIZE)               ///< tag overhead of allocated block
+#endif
 
-//
-// TODO: add more macros as needed
-//
+#define ROUND_UP(v, a)     (((v) + (a) - 1) & ~((uintptr_t)(a) - 1)) ///< round v up to multiple of a
+
+#define NEXT_BLK(p)        ((p)+GET_SIZE(p))           ///< get header of next block
+#define PREV_BLK(p)        ((p)-GET_SIZE(PREV_PTR(p))) ///< get header of previous block
+
+#define NEXT_LIST_PTR(p)   (NEXT_PTR(p))               ///< location of next pointer in free block
+#define PREV_LIST_PTR(p)   (NEXT_PTR(NEXT_PTR(p)))     ///< location of prev pointer in free block
+#define NEXT_LIST_GET(p)   (UNLINK(GET(NEXT_LIST_PTR(p))))///< get next pointer of free block
+#define PREV_LIST_GET(p)   (UNLINK(GET(PREV_LIST_PTR(p))))///< get prev pointer of free block
+#define NEXT_LIST_SET(p,n) (PUT(NEXT_LIST_PTR(p), LINK(n))) ///< set next pointer of free block
+#define PREV_LIST_SET(p,n) (PUT(PREV_LIST_PTR(p), LINK(n))) ///< set prev pointer of free block
+
+#define TREE_LEFT(p)       ((TYPE*)NEXT_PTR(p))        ///< location of left child link in free block
+#define TREE_RIGHT(p)      ((TYPE*)NEXT_PTR(NEXT_PTR(p))) ///< location of right child link in free block
+#define TREE_GET(s)        (UNLINK(*(s)))              ///< get node referenced by link location s
+#define TREE_SET(s, p)     (*(s) = LINK(p))            ///< store node p in link location s
+#define TREE_PRIO(p)       (WORD(p) * 0x9e3779b97f4a7c15UL) ///< heap priority of tree node
+#define TREE_LESS(a, b)    ((GET_SIZE(a) < GET_SIZE(b)) || \
+                            ((GET_SIZE(a) == GET_SIZE(b)) && ((a) < (b)))) ///< node ordering
+
+#define SEG_EXACT          32                          ///< number of exact-size classes
+#define SEG_LIMIT          (SEG_EXACT*BS)              ///< largest block size in an exact class
+#define SEG_NUM            64                          ///< total number of size classes
+
+#define TLSF_SL_LOG2       4                           ///< log2 of number of second-level lists
+#define TLSF_SL            (1<<TLSF_SL_LOG2)           ///< number of second-level lists
+#define TLSF_FL            64                          ///< number of first-level ranges
+
+#define QUICK_NUM          32                          ///< number of quick lists
+#define QUICK_LIMIT        (QUICK_NUM*BS)              ///< largest block size kept on a quick list
+#define QUICK_THLD         (1<<16)                     ///< bytes on quick lists forcing consolidation
+
+#define TCACHE_BLOCKS      64                          ///< number of cached block size classes
+#define TCACHE_LIMIT       (TCACHE_BLOCKS*BS)          ///< largest block size kept in a thread cache
+#define TCACHE_CLASSES     (SLAB_CLASSES+TCACHE_BLOCKS)///< number of thread cache classes
+#define TCACHE_DEPTH       32                          ///< maximal number of cached objects per class
+#define TCACHE_BATCH       16                          ///< objects moved per refill/flush
+
+#define MMAP_OFS           (BS + HDR_OFS + TYPE_SIZE)  ///< offset of payload in mapped region
+#define MMAP_SIZE(p)       (*(size_t*)((p) - MMAP_OFS))///< region size of mapped block p
+
+#define GROW_MAX           (1<<24)                     ///< largest heap extension
+#define GROW_DIV           128                          ///< heap extensions are at most 1/GROW_DIV of the heap
+
+#define REMOTE_THLD        256                         ///< queued remote frees forcing a drain
+
+#define REGION_CHUNK       (1<<16)                     ///< default size of region chunks
+#define REGION_MIN         (1<<10)                     ///< smallest region chunk
+
+#ifdef MM_THREADS
+  #define LOCK(a)          pthread_mutex_lock(&(a)->lock)   ///< acquire lock of arena a
+  #define UNLOCK(a)        pthread_mutex_unlock(&(a)->lock) ///< release lock of arena a
+#else
+  #define LOCK(a)                                      ///< acquire lock of arena a
+  #define UNLOCK(a)                                    ///< release lock of arena a
+#endif
+
+#define SLAB_SIZE          2048                        ///< slab window size. Must be a power of 2
+#define SLAB_ALIGN         16                          ///< slab object size granularity
+#define SLAB_MAX           256                         ///< largest request served from slabs
+#define SLAB_CLASSES       (SLAB_MAX/SLAB_ALIGN)       ///< number of slab size classes
+#define SLAB_MAPW          (SLAB_SIZE/SLAB_ALIGN/64)   ///< number of words in slab bitmap
+#define SLAB_OBJ_OFS       ROUND_UP(sizeof(Slab), BS)  ///< offset of first object in slab window
+#define SLAB_HDR_OFS       (BS - HDR_OFS)              ///< offset of slab window from block header
+#define IS_SLAB_OBJ(p)     (!IS_REGULAR_OBJ(p) && slab_marked(p)) ///< pointer refers to slab object
+#define SLAB_OF(p)         ((Slab*)(WORD(p) & ~((uintptr_t)SLAB_SIZE-1))) ///< descriptor of slab object
+#define SLAB_WIN(a, p)     (WORD(p)/SLAB_SIZE - WORD((a)->ds_heap_start)/SLAB_SIZE) ///< slab map index of p in arena a
+
+#define MM_ALIGN           (HDR_OFS + TYPE_SIZE)       ///< natural alignment of payloads
+#define ALIGN_HDR_OFS      (BS - HDR_OFS)              ///< offset of aligned payload from block header
+#define IS_REGULAR_OBJ(p)  ((WORD(p) & (BS-1)) == MM_ALIGN) ///< pointer refers to payload of regular block
+#define BLOCK_OF(p)        (IS_REGULAR_OBJ(p) ? PREV_PTR(p) : (p) - ALIGN_HDR_OFS) ///< header of non-slab payload
+/// @}
+
+
+/// @brief slab descriptor located at the start of the slab window
+typedef struct __slab {
+  struct __slab *next, *prev;     ///< list of slabs with free objects of the same size class
+  unsigned int  osize;            ///< object size
+  unsigned int  nobj;             ///< number of objects in slab
+  unsigned int  nfree;            ///< number of free objects
+  unsigned int  cls;              ///< size class
+  unsigned long map[SLAB_MAPW];   ///< used objects (1: used, 0: free)
+} Slab;
+
+#ifdef MM_THREADS
+/// @brief per-thread cache of allocated objects. Cached objects are linked through their first
+///        payload word and keep their allocated status in the heap.
+typedef struct __tcache {
+  void          *list[TCACHE_CLASSES];  ///< cached objects per class
+  unsigned int  count[TCACHE_CLASSES];  ///< number of cached objects per class
+  unsigned long gen;                    ///< heap generation the cached objects belong to
+} TCache;
+#endif
+
+
+/// @brief region descriptor, located in the region's first chunk behind the chunk link
+struct __region {
+  void          *chunk;           ///< most recent chunk; chunks are linked through their first word
+  void          *cur;             ///< next free byte of the current chunk
+  void          *end;             ///< end of the current chunk
+  size_t        chunk_size;       ///< size of regular chunks
+};
+
+
+/// @brief an arena: a heap in its own data segment with its own free lists and lock
+typedef struct __arena {
+  int           seg;                          ///< data segment id
+  void          *ds_heap_start;               ///< physical start of data segment
+  void          *ds_heap_brk;                 ///< physical end of data segment
+  void          *ds_heap_end;                 ///< largest possible end of data segment
+  void          *heap_start;                  ///< logical start of heap
+  void          *heap_end;                    ///< logical end of heap
+  void          *free_list;                   ///< head of explicit free list
+  TYPE          free_tree;                    ///< link to root of free block tree
+  void          *seg_list[SEG_NUM];           ///< heads of segregated free lists
+  void          *tlsf_list[TLSF_FL][TLSF_SL]; ///< heads of TLSF free lists
+  unsigned long tlsf_fl_bitmap;               ///< non-empty first-level ranges
+  unsigned int  tlsf_sl_bitmap[TLSF_FL];      ///< non-empty second-level lists
+  void          *quick_list[QUICK_NUM];       ///< heads of exact-size quick lists
+  size_t        quick_bytes;                  ///< total size of blocks on quick lists
+  Slab          *slab_list[SLAB_CLASSES];     ///< slabs with free objects per size class
+  unsigned long *slab_map;                    ///< SLAB_SIZE windows of the data segment holding a slab
+  size_t        slab_map_size;                ///< size of slab_map in bytes
+  size_t        trim_keep;                    ///< free bytes kept at the end when trimming
+  size_t        grow;                         ///< size of next heap extension
+  void          *zero;                        ///< memory above has never been allocated (zero mark)
+  void          *rover;                       ///< next fit: block where the next search starts
+#ifdef MM_THREADS
+  pthread_mutex_t lock;                       ///< arena lock
+  void          *remote;                      ///< stack of objects freed by other threads
+  long          nremote;                      ///< approximate number of objects on remote stack
+#endif
+} Arena;
+
+
+/// @name arenas
+/// @{
+static Arena arenas[MM_MAXARENAS];                     ///< arenas (arena 0 uses data segment 0)
+static int  narenas        = 1;                        ///< number of arenas
+static int  narenas_next   = 1;                        ///< number of arenas for next mm_init()
+static ArenaAssignment arena_assign = aa_RoundRobin;   ///< assignment of threads to arenas
+static __thread Arena *arena = &arenas[0];             ///< arena operated on by the calling thread
+static __thread Arena *arena_home = NULL;              ///< arena assigned to the calling thread
+static __thread unsigned long arena_gen = 0;           ///< heap generation of arena_home
+static unsigned long arena_rr      = 0;                ///< round-robin assignment counter
+static unsigned long mm_generation = 0;                ///< incremented by every mm_init()
+/// @}
+
+
+/// @name slabs
+/// @{
+static int  mm_slab        = 1;                        ///< serve small requests from slabs (0: off)
+/// @}
+
+
+#ifdef MM_THREADS
+/// @name threads
+/// @{
+static pthread_key_t  tcache_key;                      ///< flushes thread caches on thread exit
+static pthread_once_t tcache_once = PTHREAD_ONCE_INIT; ///< creates tcache_key
+static __thread TCache tcache;                         ///< cache of the calling thread
+static int  mm_tcache      = 1;                        ///< use thread caches (0: off)
+static int  mm_remote      = 1;                        ///< queue frees of other arenas' objects (0: off)
 /// @}
+#endif
 
 
 /// @name Logging facilities
@@ -204,244 +602,2404 @@ static void mm_panic(const char *func, ...)
 /// @}
 
 
-static void* bf_get_free_block_implicit(size_t size);
-static void* bf_get_free_block_explicit(size_t size);
+/// @name Free list management
+/// @{
 
-void mm_init(FreelistPolicy fp)
+/// @brief compute the size class of a block for the segregated free lists
+/// @param size block size in bytes (multiple of BS)
+/// @retval int index into seg_list
+static inline int seg_class(size_t size)
 {
-  LOG(1, "mm_init()");
+  if (size <= SEG_LIMIT) return size/BS - 1;
 
-  //
-  // set free list policy
-  //
-  freelist_policy = fp;
-  switch (freelist_policy)
-  {
-    case fp_Implicit:
-      get_free_block = bf_get_free_block_implicit;
-      break;
-      
+  int c = SEG_EXACT + (63 - __builtin_clzl(size-1)) - __builtin_ctzl(SEG_LIMIT);
+  return c < SEG_NUM ? c : SEG_NUM-1;
+}
+
+/// @brief compute the first- and second-level TLSF index of a block
+/// @param size block size in bytes
+/// @param[out] fl first-level index
+/// @param[out] sl second-level index
+static inline void tlsf_mapping(size_t size, int *fl, int *sl)
+{
+  *fl = 63 - __builtin_clzl(size);
+  *sl = (size >> (*fl - TLSF_SL_LOG2)) - TLSF_SL;
+}
+
+/// @brief return the head of the free list that holds blocks of @a size bytes
+/// @param size block size in bytes
+/// @retval void** pointer to list head
+/// @retval NULL if the current policy does not maintain explicit lists
+static inline void** fl_head(size_t size)
+{
+  switch (freelist_policy) {
     case fp_Explicit:
-      get_free_block = bf_get_free_block_explicit;
-      break;
-    
-    default:
-      PANIC("Non supported freelist policy.");
-      break;
+    case fp_QuickFit:   return &arena->free_list;
+    case fp_Segregated: return &arena->seg_list[seg_class(size)];
+    case fp_TLSF:       { int fl, sl; tlsf_mapping(size, &fl, &sl); return &arena->tlsf_list[fl][sl]; }
+    default:            return NULL;
   }
+}
 
-  //
-  // retrieve heap status and perform a few initial sanity checks
-  //
-  ds_heap_stat(&ds_heap_start, &ds_heap_brk, NULL);
-  PAGESIZE = ds_getpagesize();
+/// @brief insert free block @a blk into the free block tree
+/// @param blk header of free block
+static void tree_insert(void *blk)
+{
+  unsigned long prio = TREE_PRIO(blk);
 
-  LOG(2, "  ds_heap_start:          %p\n"
-         "  ds_heap_brk:            %p\n"
-         "  PAGESIZE:               %d\n",
-         ds_heap_start, ds_heap_brk, PAGESIZE);
+  // descend to the position where blk becomes the root of a subtree
+  TYPE *slot = &arena->free_tree;
+  void *cur;
+  while (((cur = TREE_GET(slot)) != NULL) && (TREE_PRIO(cur) >= prio)) {
+    slot = TREE_LESS(blk, cur) ? TREE_LEFT(cur) : TREE_RIGHT(cur);
+  }
 
-  if (ds_heap_start == NULL) PANIC("Data segment not initialized.");
-  if (ds_heap_start != ds_heap_brk) PANIC("Heap not clean.");
-  if (PAGESIZE == 0) PANIC("Reported pagesize == 0.");
+  // split the subtree at blk into the nodes less and greater than blk
+  TYPE *l = TREE_LEFT(blk), *r = TREE_RIGHT(blk);
+  while (cur != NULL) {
+    if (TREE_LESS(cur, blk)) {
+      TREE_SET(l, cur);
+      l = TREE_RIGHT(cur);
+      cur = TREE_GET(l);
+    } else {
+      TREE_SET(r, cur);
+      r = TREE_LEFT(cur);
+      cur = TREE_GET(r);
+    }
+  }
+  *l = *r = 0;
+  TREE_SET(slot, blk);
+}
 
-  //
-  // initialize heap
-  //
-  // TODO
+/// @brief remove free block @a blk from the free block tree
+/// @param blk header of free block
+static void tree_remove(void *blk)
+{
+  TYPE *slot = &arena->free_tree;
+  void *cur;
+  while ((cur = TREE_GET(slot)) != blk) {
+    assert(cur != NULL);
+    slot = TREE_LESS(blk, cur) ? TREE_LEFT(cur) : TREE_RIGHT(cur);
+  }
 
-  //
-  // heap is initialized
-  //
-  mm_initialized = 1;
+  // merge the two subtrees of blk into its slot
+  void *l = TREE_GET(TREE_LEFT(blk)), *r = TREE_GET(TREE_RIGHT(blk));
+  while ((l != NULL) && (r != NULL)) {
+    if (TREE_PRIO(l) > TREE_PRIO(r)) {
+      TREE_SET(slot, l);
+      slot = TREE_RIGHT(l);
+      l = TREE_GET(slot);
+    } else {
+      TREE_SET(slot, r);
+      slot = TREE_LEFT(r);
+      r = TREE_GET(slot);
+    }
+  }
+  TREE_SET(slot, l != NULL ? l : r);
 }
 
-
-/// @brief find and return a free block of at least @a size bytes (best fit)
-/// @param size size of block (including header & footer tags), in bytes
-/// @retval void* pointer to header of large enough free block
-/// @retval NULL if no free block of the requested size is avilable
-static void* bf_get_free_block_implicit(size_t size)
+/// @brief insert free block @a blk at the head of its free list (LIFO) or, with address-ordered
+///        placement, before the first block at a higher address
+/// @param blk header of free block
+static void fl_insert(void *blk)
 {
-  LOG(1, "bf_get_free_block_implicit(0x%lx (%lu))", size, size);
+  if (freelist_policy == fp_Tree) {
+    tree_insert(blk);
+    return;
+  }
 
-  assert(mm_initialized);
+  void **head = fl_head(GET_SIZE(blk));
+  if (head == NULL) return;
 
-  //
-  // TODO
-  //
+  void *prev = NULL;
+  if (placement == pp_AddressOrdered) {
+    for (void *p = *head; (p != NULL) && (p < blk); p = NEXT_LIST_GET(p)) prev = p;
+  }
 
-  return NULL;
-}
+  if (prev == NULL) {
+    NEXT_LIST_SET(blk, *head);
+    PREV_LIST_SET(blk, NULL);
+    if (*head != NULL) PREV_LIST_SET(*head, blk);
+    *head = blk;
+  } else {
+    void *next = NEXT_LIST_GET(prev);
+    NEXT_LIST_SET(blk, next);
+    PREV_LIST_SET(blk, prev);
+    if (next != NULL) PREV_LIST_SET(next, blk);
+    NEXT_LIST_SET(prev, blk);
+  }
 
+  if (freelist_policy == fp_TLSF) {
+    int fl, sl;
+    tlsf_mapping(GET_SIZE(blk), &fl, &sl);
+    arena->tlsf_fl_bitmap |= 1UL << fl;
+    arena->tlsf_sl_bitmap[fl] |= 1U << sl;
+  }
+}
 
-/// @brief find and return a free block of at least @a size bytes (best fit)
-/// @param size size of block (including header & footer tags), in bytes
-/// @retval void* pointer to header of large enough free block
-/// @retval NULL if no free block of the requested size is avilable
-static void* bf_get_free_block_explicit(size_t size)
+/// @brief unlink free block @a blk from its free list
+/// @param blk header of free block
+static void fl_remove(void *blk)
 {
-  LOG(1, "bf_get_free_block_explicit(0x%lx (%lu))", size, size);
+  if (freelist_policy == fp_Tree) {
+    tree_remove(blk);
+    return;
+  }
 
-  assert(mm_initialized);
-  
-  //
-  // TODO
-  //
+  void **head = fl_head(GET_SIZE(blk));
+  if (head == NULL) return;
 
-  return NULL;
+  void *next = NEXT_LIST_GET(blk);
+  void *prev = PREV_LIST_GET(blk);
+
+  if (blk == arena->rover) arena->rover = next;
+
+  if (prev != NULL) NEXT_LIST_SET(prev, next);
+  else *head = next;
+  if (next != NULL) PREV_LIST_SET(next, prev);
+
+  if ((freelist_policy == fp_TLSF) && (*head == NULL)) {
+    int fl, sl;
+    tlsf_mapping(GET_SIZE(blk), &fl, &sl);
+    arena->tlsf_sl_bitmap[fl] &= ~(1U << sl);
+    if (arena->tlsf_sl_bitmap[fl] == 0) arena->tlsf_fl_bitmap &= ~(1UL << fl);
+  }
 }
 
+/// @}
 
-void* mm_malloc(size_t size)
-{
-  LOG(1, "mm_malloc(0x%lx (%lu))", size, size);
 
-  assert(mm_initialized);
+/// @name Block management
+/// @{
 
-  //
-  // TODO
-  //
+/// @brief write header and footer of block @a blk. With ELIDE_FOOTER, allocated blocks get no
+///        footer, the PREV_ALLOC bit of @a blk is preserved, and the PREV_ALLOC bit of the
+///        following header is updated. Allocated blocks raise the zero mark of the arena, and a
+///        block that covers the next fit rover of the implicit list becomes the new rover.
+/// @param blk header of block
+/// @param size block size
+/// @param status block status (ALLOC/FREE)
+static inline void set_tags(void *blk, size_t size, TYPE status)
+{
+  if ((status & ALLOC) && (blk + size > arena->zero)) arena->zero = blk + size;
+  if ((arena->rover > blk) && (arena->rover < blk + size)) arena->rover = blk;
 
-  return NULL;
+#ifdef ELIDE_FOOTER
+  PUT(blk, PACK(size, status) | (GET(blk) & PREV_ALLOC));
+  if (status == FREE) PUT(blk + size - TYPE_SIZE, PACK(size, status));
+
+  void *next = blk + size;
+  PUT(next, (GET(next) & ~(TYPE)PREV_ALLOC) | (status & ALLOC ? PREV_ALLOC : 0));
+#else
+  PUT(blk, PACK(size, status));
+  PUT(blk + size - TYPE_SIZE, PACK(size, status));
+#endif
 }
 
+/// @brief check whether the block preceeding @a blk is free
+/// @param blk header of block
+/// @retval 1 if the previous block is free
+/// @retval 0 otherwise
+static inline int prev_free(void *blk)
+{
+#ifdef ELIDE_FOOTER
+  return (GET(blk) & PREV_ALLOC) == 0;
+#else
+  return GET_STATUS(PREV_PTR(blk)) == FREE;
+#endif
+}
 
-void* mm_calloc(size_t nmemb, size_t size)
+/// @brief merge free block @a blk with its free neighbors. Neighbors are removed from their free
+///        lists; the merged block is not inserted.
+/// @param blk header of free block (not on any free list)
+/// @retval void* header of merged block
+static void* coalesce(void *blk)
 {
-  LOG(1, "mm_calloc(0x%lx, 0x%lx (%lu))", nmemb, size, size);
+  size_t size = GET_SIZE(blk);
 
-  assert(mm_initialized);
+  void *next = NEXT_BLK(blk);
+  if (GET_STATUS(next) == FREE) {
+    fl_remove(next);
+    size += GET_SIZE(next);
+  }
 
-  //
-  // calloc is simply malloc() followed by memset()
-  //
-  void *payload = mm_malloc(nmemb * size);
+  if (prev_free(blk)) {
+    void *prev = PREV_BLK(blk);
+    fl_remove(prev);
+    size += GET_SIZE(prev);
+    blk = prev;
+  }
 
-  if (payload != NULL) memset(payload, 0, nmemb * size);
+  set_tags(blk, size, FREE);
 
-  return payload;
+  return blk;
 }
 
-
-void* mm_realloc(void *ptr, size_t size)
+/// @brief return the memory of the free last block @a blk to the data segment if it exceeds the
+///        size of the last heap extension by more than SHRINKTHLD. The block keeps the size of
+///        the last extension, so that an allocation/free pair at the end of the heap does not
+///        sbrk() in both directions.
+/// @param blk header of free block (not on any free list)
+static void trim_heap(void *blk)
 {
-  LOG(1, "mm_realloc(%p, 0x%lx (%lu))", ptr, size, size);
+  size_t size = GET_SIZE(blk);
 
-  assert(mm_initialized);
+  if ((NEXT_BLK(blk) != arena->heap_end) || (size <= arena->trim_keep + SHRINKTHLD)) return;
 
-  //
-  // TODO
-  //
+  size_t dec = size - arena->trim_keep;
 
-  return NULL;
-}
+  LOG(2, "  trimming heap by 0x%lx bytes", dec);
 
+  if (ds_sbrk_seg(arena->seg, -(intptr_t)dec) == (void*)-1) return;
+  ds_heap_stat_seg(arena->seg, NULL, &arena->ds_heap_brk, NULL);
 
-void mm_free(void *ptr)
-{
-  LOG(1, "mm_free(%p)", ptr);
+  // the old footer and sentinel may survive the trim; treat the released area as used
+  arena->zero = MAX(arena->zero, arena->heap_end + TYPE_SIZE);
 
-  assert(mm_initialized);
+  arena->heap_end -= dec;
+  PUT(arena->heap_end, PACK(0, ALLOC));
+  set_tags(blk, size - dec, FREE);
 
-  //
-  // TODO
-  //
-  
+  // the heap is no longer growing; restart with small extensions
+  arena->grow = CHUNKSIZE;
 }
 
+/// @brief allocate a block of @a size bytes at the start of the @a avail bytes at @a blk, which
+///        are not on any free list. The remainder, if large enough, is turned into a free block,
+///        merged with a free successor, and inserted into the free list; otherwise the block
+///        takes all @a avail bytes. Only the allocated block raises the zero mark.
+/// @param blk header of the block
+/// @param avail available bytes at @a blk (multiple of BS)
+/// @param size block size (multiple of BS)
+static void carve(void *blk, size_t avail, size_t size)
+{
+  if (avail - size < BS) size = avail;
 
-void mm_setloglevel(int level)
+  set_tags(blk, size, ALLOC);
+  if (size == avail) return;
+
+  void *rem = blk + size;
+  set_tags(rem, avail - size, FREE);
+  rem = coalesce(rem);
+  trim_heap(rem);
+  fl_insert(rem);
+}
+
+/// @brief split allocated block @a blk to @a size bytes. The remainder, if large enough, is
+///        turned into a free block, merged with a free successor, and inserted into the free list.
+/// @param blk header of allocated block
+/// @param size new block size (multiple of BS)
+static void split(void *blk, size_t size)
 {
-  mm_loglevel = level;
+  size_t bsize = GET_SIZE(blk);
+
+  if (bsize - size < BS) return;
+
+  carve(blk, bsize, size);
 }
 
+/// @brief allocate @a size bytes from free block @a blk
+/// @param blk header of free block (on the free list)
+/// @param size requested block size (multiple of BS)
+static void place(void *blk, size_t size)
+{
+  fl_remove(blk);
+  carve(blk, GET_SIZE(blk), size);
+}
 
-void mm_check(void)
+/// @brief extend the heap such that the free block at its end holds at least @a size bytes. A
+///        free last block only needs to be extended by the shortfall. The extension is at least
+///        arena->grow bytes (limited to 1/GROW_DIV of the heap), and arena->grow doubles with
+///        every extension up to GROW_MAX. The new area is merged with a free last block and
+///        inserted into the free list.
+/// @param size minimal size of the free block at the end of the heap
+/// @retval void* header of the free block at the end of the heap
+/// @retval NULL if the data segment is exhausted
+static void* extend_heap(size_t size)
 {
-  assert(mm_initialized);
+  size = ROUND_UP(size, BS);
+  if (prev_free(arena->heap_end)) size -= MIN(size, GET_SIZE(PREV_BLK(arena->heap_end)));
+
+  size_t heap = arena->heap_end - arena->heap_start;
+  size = MAX(size, MIN(arena->grow, MAX(ROUND_UP(heap/GROW_DIV, BS), CHUNKSIZE)));
+  arena->grow = MIN(2*arena->grow, GROW_MAX);
+
+  LOG(2, "  extending heap by 0x%lx bytes", size);
+
+  if (ds_sbrk_seg(arena->seg, size) == (void*)-1) return NULL;
+  ds_heap_stat_seg(arena->seg, NULL, &arena->ds_heap_brk, NULL);
+  arena->trim_keep = size;
+
+  void *blk = arena->heap_end;
+  set_tags(blk, size, FREE);
+  arena->heap_end += size;
+  PUT(arena->heap_end, PACK(0, ALLOC));
+
+  // merging with a free last block leaves its footer and the old sentinel behind in the free
+  // block; clear them if they lie above the zero mark
+  void *old_end = blk;
+  blk = coalesce(blk);
+  if ((blk != old_end) && (old_end - TYPE_SIZE >= arena->zero)) {
+    PUT(old_end - TYPE_SIZE, 0);
+    PUT(old_end, 0);
+  }
+  fl_insert(blk);
 
-  void *p;
+  return blk;
+}
 
-  char *fpstr;
-  if (freelist_policy == fp_Implicit) fpstr = "Implicit";
-  else if (freelist_policy == fp_Explicit) fpstr = "Explicit";
-  else fpstr = "invalid";
+/// @brief release the physical pages of free block @a blk if it is at least mm_decommit_thld
+///        bytes large. The header, the free list/tree links, and the footer stay intact. Free
+///        neighbors that were large enough themselves have already been decommitted; only the
+///        page next to the freed range is released again for them.
+/// @param blk header of free block (result of coalescing)
+/// @param freed start of the range freed into @a blk
+/// @param fsize size of the range freed into @a blk
+static void decommit_block(void *blk, void *freed, size_t fsize)
+{
+  size_t size = GET_SIZE(blk);
 
-  printf("----------------------------------------- mm_check ----------------------------------------------\n");
-  printf("  ds_heap_start:          %p\n", ds_heap_start);
-  printf("  ds_heap_brk:            %p\n", ds_heap_brk);
-  printf("  heap_start:             %p\n", heap_start);
-  printf("  heap_end:               %p\n", heap_end);
-  printf("  free list policy:       %s\n", fpstr);
+  if ((mm_decommit_thld == 0) || (size < mm_decommit_thld)) return;
 
-  printf("\n");
-  p = PREV_PTR(heap_start);
-  printf("  initial sentinel:       %p: size: %6lx (%7ld), status: %s\n",
-         p, GET_SIZE(p), GET_SIZE(p), GET_STATUS(p) == ALLOC ? "allocated" : "free");
-  p = heap_end;
-  printf("  end sentinel:           %p: size: %6lx (%7ld), status: %s\n",
-         p, GET_SIZE(p), GET_SIZE(p), GET_STATUS(p) == ALLOC ? "allocated" : "free");
-  printf("\n");
+  void *lo = blk + BS, *hi = blk + size - TYPE_SIZE;
+  void *fend = freed + fsize;
 
-  if(freelist_policy == fp_Implicit){
-    printf("    %-14s  %8s  %10s  %10s  %8s  %s\n", "address", "offset", "size (hex)", "size (dec)", "payload", "status");
-  }
-  else if(freelist_policy == fp_Explicit){
-    printf("    %-14s  %8s  %10s  %10s  %8s  %-14s  %-14s  %s\n", "address", "offset", "size (hex)", "size (dec)", "payload", "next", "prev", "status");
+  if ((size_t)(freed - blk) >= mm_decommit_thld) lo = MAX(lo, freed - PAGESIZE);
+  if ((blk + size > fend) && ((size_t)(blk + size - fend) >= mm_decommit_thld)) {
+    hi = MIN(hi, fend + PAGESIZE);
   }
 
-  long errors = 0;
-  p = heap_start;
-  while (p < heap_end) {
-    char *ofs_str, *size_str;
+  if (hi > lo) ds_decommit(lo, hi - lo);
+}
 
-    TYPE hdr = GET(p);
-    TYPE size = SIZE(hdr);
-    TYPE status = STATUS(hdr);
+/// @brief release allocated block @a blk to the free list
+/// @param blk header of allocated block
+static void free_block(void *blk)
+{
+  void *freed = blk;
+  size_t fsize = GET_SIZE(blk);
+
+  set_tags(blk, fsize, FREE);
+  blk = coalesce(blk);
+  trim_heap(blk);
+  decommit_block(blk, freed, fsize);
+  fl_insert(blk);
+}
 
-    void *next = NEXT_LIST_GET(p);
-    void *prev = PREV_LIST_GET(p);
+/// @brief park allocated block @a blk on the quick list of its size. The block keeps its
+///        allocated status, so it is neither coalesced nor visible on the free lists.
+/// @param blk header of allocated block (size <= QUICK_LIMIT)
+static void quick_push(void *blk)
+{
+  size_t size = GET_SIZE(blk);
+  int c = size/BS - 1;
 
-    if (asprintf(&ofs_str, "0x%lx", p-heap_start) < 0) ofs_str = NULL;
-    if (asprintf(&size_str, "0x%lx", size) < 0) size_str = NULL;
+  set_tags(blk, size, ALLOC | QUICK);
+  NEXT_LIST_SET(blk, arena->quick_list[c]);
+  arena->quick_list[c] = blk;
+  arena->quick_bytes += size;
+}
 
-    if(freelist_policy == fp_Implicit){
-      printf("    %p  %8s  %10s  %10ld  %8ld  %s\n",
-                p, ofs_str, size_str, size, size-2*TYPE_SIZE, status == ALLOC ? "allocated" : "free");
-    }
-    else if(freelist_policy == fp_Explicit){
-      printf("    %p  %8s  %10s  %10ld  %8ld  %-14p  %-14p  %s\n",
-                p, ofs_str, size_str, size, size-2*TYPE_SIZE,
-                status == ALLOC ? NULL : next, status == ALLOC ? NULL : prev,
-                status == ALLOC ? "allocated" : "free");
-    }
-    
-    free(ofs_str);
-    free(size_str);
+/// @brief take a block of exactly @a size bytes from its quick list
+/// @param size block size (multiple of BS, <= QUICK_LIMIT)
+/// @retval void* header of allocated block
+/// @retval NULL if the quick list is empty
+static void* quick_pop(size_t size)
+{
+  int c = size/BS - 1;
+  void *blk = arena->quick_list[c];
 
-    void *fp = p + size - TYPE_SIZE;
-    TYPE ftr = GET(fp);
-    TYPE fsize = SIZE(ftr);
-    TYPE fstatus = STATUS(ftr);
+  if (blk == NULL) return NULL;
 
-    if ((size != fsize) || (status != fstatus)) {
-      errors++;
-      printf("    --> ERROR: footer at %p with different properties: size: %lx, status: %lx\n", 
-             fp, fsize, fstatus);
-      mm_panic("mm_check");
-    }
+  arena->quick_list[c] = NEXT_LIST_GET(blk);
+  arena->quick_bytes -= size;
+  set_tags(blk, size, ALLOC);
 
-    p = p + size;
-    if (size == 0) {
-      printf("    WARNING: size 0 detected, aborting traversal.\n");
-      break;
+  return blk;
+}
+
+/// @brief release all blocks on the quick lists and coalesce them with their free neighbors
+static void quick_consolidate(void)
+{
+  LOG(2, "  consolidating 0x%lx bytes from quick lists", arena->quick_bytes);
+
+  for (int c = 0; c < QUICK_NUM; c++) {
+    void *blk = arena->quick_list[c];
+    while (blk != NULL) {
+      void *next = NEXT_LIST_GET(blk);
+      free_block(blk);
+      blk = next;
     }
+    arena->quick_list[c] = NULL;
+  }
+  arena->quick_bytes = 0;
+}
+
+/// @brief find a free block of at least @a size bytes. On a miss, blocks on the quick lists are
+///        consolidated and the search is repeated before the heap is extended.
+/// @param size block size (multiple of BS)
+/// @retval void* header of free block (on the free list)
+/// @retval NULL if the data segment is exhausted
+static void* find_block(size_t size)
+{
+  void *blk = get_free_block(size);
+
+  if ((blk == NULL) && (arena->quick_bytes > 0)) {
+    quick_consolidate();
+    blk = get_free_block(size);
   }
+  if (blk == NULL) blk = extend_heap(size);
 
-  printf("\n");
-  if ((p == heap_end) && (errors == 0)) printf("  Block structure coherent.\n");
-  printf("-------------------------------------------------------------------------------------------------\n");
+  return blk;
 }
 
+/// @brief allocate a block of @a size bytes whose header is located at @a ofs bytes before an
+///        address aligned to @a align. The leading slack is returned to the free list.
+/// @param size block size (multiple of BS)
+/// @param align alignment (power of 2, at least BS)
+/// @param ofs offset of the aligned address from the block header
+/// @retval void* header of allocated block
+/// @retval NULL if the data segment is exhausted
+static void* alloc_aligned_block(size_t size, size_t align, size_t ofs)
+{
+  size_t need = size + align - BS;
 
+  void *blk = find_block(need);
+  if (blk == NULL) return NULL;
+
+  fl_remove(blk);
+
+  size_t bsize = GET_SIZE(blk);
+  void *aligned = PTR(ROUND_UP(WORD(blk) + ofs, align) - ofs);
+  size_t gap = aligned - blk;
+
+  if (gap > 0) {
+    set_tags(blk, gap, FREE);
+    fl_insert(blk);
+  }
+
+  carve(aligned, bsize - gap, size);
+
+  return aligned;
+}
+
+/// @brief convert a payload size into a block size (header + payload + footer, aligned to BS)
+/// @param size payload size in bytes
+/// @retval size_t block size in bytes
+/// @retval 0 if the request is too large
+static inline size_t block_size(size_t size)
+{
+  if (size > (size_t)SIZE_MASK - BS - ALLOC_OVERHEAD) return 0;
+  return MAX(ROUND_UP(size + ALLOC_OVERHEAD, BS), BS);
+}
+
+/// @}
+
+
+/// @name Slab management
+/// @{
+
+static inline Arena* arena_of(void *ptr);
+
+/// @brief check whether the SLAB_SIZE window containing @a ptr holds a slab. The map of the
+///        owning arena is consulted, never the memory around @a ptr. Needs no lock: the window of
+///        an allocated object does not change while the object is live.
+static inline int slab_marked(void *ptr)
+{
+  Arena *a = arena_of(ptr);
+  size_t win = SLAB_WIN(a, ptr);
+
+  return (__atomic_load_n(&a->slab_map[win/64], __ATOMIC_RELAXED) >> (win%64)) & 1;
+}
+
+/// @brief mark (@a used = 1) or unmark (@a used = 0) the window of @a slab in the slab map
+static inline void slab_mark(Slab *slab, int used)
+{
+  size_t win = SLAB_WIN(arena, slab);
+
+  if (used) __atomic_fetch_or(&arena->slab_map[win/64], 1UL << (win%64), __ATOMIC_RELAXED);
+  else __atomic_fetch_and(&arena->slab_map[win/64], ~(1UL << (win%64)), __ATOMIC_RELAXED);
+}
+
+/// @brief allocate a new slab for size class @a cls and insert it into the slab list
+/// @param cls size class
+/// @retval Slab* new slab
+/// @retval NULL if the data segment is exhausted
+static Slab* slab_create(int cls)
+{
+  void *blk = alloc_aligned_block(SLAB_SIZE + BS, SLAB_SIZE, SLAB_HDR_OFS);
+  if (blk == NULL) return NULL;
+
+  set_tags(blk, GET_SIZE(blk), ALLOC | SLAB);
+
+  Slab *slab = PTR(blk + SLAB_HDR_OFS);
+  slab->osize = (cls + 1) * SLAB_ALIGN;
+  slab->nobj  = (SLAB_SIZE + HDR_OFS - TYPE_SIZE - SLAB_OBJ_OFS) / slab->osize;
+  slab->nfree = slab->nobj;
+  slab->cls   = cls;
+  slab_mark(slab, 1);
+
+  // mark non-existing objects as used
+  for (unsigned int w = 0; w < SLAB_MAPW; w++) {
+    unsigned int first = w*64;
+    if (first + 64 <= slab->nobj) slab->map[w] = 0;
+    else if (first >= slab->nobj) slab->map[w] = ~0UL;
+    else slab->map[w] = ~0UL << (slab->nobj - first);
+  }
+
+  slab->prev = NULL;
+  slab->next = arena->slab_list[cls];
+  if (slab->next != NULL) slab->next->prev = slab;
+  arena->slab_list[cls] = slab;
+
+  return slab;
+}
+
+/// @brief allocate an object of @a size bytes from a slab
+/// @param size requested size (1..SLAB_MAX)
+/// @retval void* pointer to object
+/// @retval NULL if the data segment is exhausted
+static void* slab_alloc(size_t size)
+{
+  int cls = (size - 1) / SLAB_ALIGN;
+
+  Slab *slab = arena->slab_list[cls];
+  if (slab == NULL) slab = slab_create(cls);
+  if (slab == NULL) return NULL;
+
+  unsigned int w = 0;
+  while (slab->map[w] == ~0UL) w++;
+
+  unsigned int bit = __builtin_ctzl(~slab->map[w]);
+  slab->map[w] |= 1UL << bit;
+
+  // full slabs leave the list
+  if (--slab->nfree == 0) {
+    arena->slab_list[cls] = slab->next;
+    if (slab->next != NULL) slab->next->prev = NULL;
+  }
+
+  return PTR(slab) + SLAB_OBJ_OFS + (w*64 + bit) * slab->osize;
+}
+
+/// @brief free slab object @a ptr
+/// @param ptr pointer to slab object
+static void slab_free(void *ptr)
+{
+  Slab *slab = SLAB_OF(ptr);
+  unsigned int idx = (ptr - PTR(slab) - SLAB_OBJ_OFS) / slab->osize;
+  unsigned int w = idx / 64, bit = idx % 64;
+
+  if (((slab->map[w] >> bit) & 1) == 0) {
+    fprintf(stderr, "ERROR: mm_free(%p): slab object is not allocated.\n", ptr);
+    return;
+  }
+  slab->map[w] &= ~(1UL << bit);
+
+  // slabs that were full re-enter the list
+  if (slab->nfree++ == 0) {
+    slab->prev = NULL;
+    slab->next = arena->slab_list[slab->cls];
+    if (slab->next != NULL) slab->next->prev = slab;
+    arena->slab_list[slab->cls] = slab;
+  }
+
+  // return empty slabs to the heap unless they are the last one of their class
+  if ((slab->nfree == slab->nobj) && ((slab->next != NULL) || (slab->prev != NULL))) {
+    if (slab->prev != NULL) slab->prev->next = slab->next;
+    else arena->slab_list[slab->cls] = slab->next;
+    if (slab->next != NULL) slab->next->prev = slab->prev;
+
+    slab_mark(slab, 0);
+    free_block(PTR(slab) - SLAB_HDR_OFS);
+  }
+}
+
+/// @}
+
+
+/// @name Aligned blocks
+/// @{
+
+/// @brief convert a payload size into the block size of an aligned payload
+/// @param size payload size in bytes
+/// @retval size_t block size in bytes
+/// @retval 0 if the request is too large
+static inline size_t aligned_block_size(size_t size)
+{
+  if (size > SIZE_MAX - ALIGN_HDR_OFS) return 0;
+  return block_size(size + ALIGN_HDR_OFS - TYPE_SIZE);
+}
+
+/// @brief allocate a payload of @a size bytes aligned to @a align. Callers hold the heap lock.
+/// @param size payload size in bytes (> 0)
+/// @param align alignment (power of 2)
+/// @retval void* pointer to payload (aligned to @a align, at least to BS)
+/// @retval NULL if the request cannot be satisfied
+static void* aligned_alloc_block(size_t size, size_t align)
+{
+  align = MAX(align, BS);
+
+  size_t bsize = aligned_block_size(size);
+  if ((bsize == 0) || (bsize > (size_t)SIZE_MASK - align)) return NULL;
+
+  void *blk = alloc_aligned_block(bsize, align, ALIGN_HDR_OFS);
+  if (blk == NULL) return NULL;
+
+  return blk + ALIGN_HDR_OFS;
+}
+
+/// @brief return the usable payload size of the aligned payload @a ptr
+static inline size_t aligned_size(void *ptr)
+{
+  return GET_SIZE(ptr - ALIGN_HDR_OFS) - ALLOC_OVERHEAD - (ALIGN_HDR_OFS - TYPE_SIZE);
+}
+
+/// @}
+
+
+static void* bf_get_free_block_implicit(size_t size);
+static void* bf_get_free_block_explicit(size_t size);
+static void* ff_get_free_block_implicit(size_t size);
+static void* ff_get_free_block_explicit(size_t size);
+static void* nf_get_free_block_implicit(size_t size);
+static void* nf_get_free_block_explicit(size_t size);
+static void* gf_get_free_block_implicit(size_t size);
+static void* gf_get_free_block_explicit(size_t size);
+static void* bf_get_free_block_segregated(size_t size);
+static void* bf_get_free_block_tree(size_t size);
+static void* gf_get_free_block_tlsf(size_t size);
+
+/// @brief placement policies: free block search of the implicit and the explicit list
+static const struct {
+  const char *name;                             ///< name of placement policy
+  void *(*implicit)(size_t);                    ///< search of the implicit list
+  void *(*explicit)(size_t);                    ///< search of the explicit list
+} placements[] = {
+  [pp_BestFit]        = { "best fit",        bf_get_free_block_implicit, bf_get_free_block_explicit },
+  [pp_FirstFit]       = { "first fit",       ff_get_free_block_implicit, ff_get_free_block_explicit },
+  [pp_NextFit]        = { "next fit",        nf_get_free_block_implicit, nf_get_free_block_explicit },
+  [pp_GoodFit]        = { "good fit",        gf_get_free_block_implicit, gf_get_free_block_explicit },
+  [pp_AddressOrdered] = { "address-ordered", ff_get_free_block_implicit, ff_get_free_block_explicit },
+};
+
+/// @brief initialize arena @a a on the empty data segment @a seg
+/// @param a arena
+/// @param seg data segment id
+static void arena_init(Arena *a, int seg)
+{
+  if (a->slab_map != NULL) munmap(a->slab_map, a->slab_map_size);
+
+  memset(a, 0, sizeof(*a));
+  a->seg = seg;
+  a->trim_keep = CHUNKSIZE;
+  a->grow = CHUNKSIZE;
+#ifdef MM_THREADS
+  pthread_mutex_init(&a->lock, NULL);
+#endif
+
+  arena = a;
+
+  ds_heap_stat_seg(seg, &arena->ds_heap_start, &arena->ds_heap_brk, &arena->ds_heap_end);
+
+  //
+  // the slab map is only backed by memory where slabs are created
+  //
+  size_t nwin = SLAB_WIN(arena, arena->ds_heap_end) + 1;
+  arena->slab_map_size = ROUND_UP((nwin + 63) / 64 * sizeof(unsigned long), PAGESIZE);
+  arena->slab_map = mmap(NULL, arena->slab_map_size, PROT_READ|PROT_WRITE,
+                         MAP_PRIVATE|MAP_ANONYMOUS|MAP_NORESERVE, -1, 0);
+  if (arena->slab_map == MAP_FAILED) PANIC("Cannot allocate slab map.");
+
+  if (ds_sbrk_seg(seg, CHUNKSIZE) == (void*)-1) PANIC("Cannot initialize heap.");
+  ds_heap_stat_seg(seg, NULL, &arena->ds_heap_brk, NULL);
+
+  arena->heap_start = PTR(ROUND_UP(WORD(arena->ds_heap_start) + TYPE_SIZE - HDR_OFS, BS) + HDR_OFS);
+  arena->heap_end   = PTR(((WORD(arena->ds_heap_brk) - TYPE_SIZE - HDR_OFS) & BS_MASK) + HDR_OFS);
+
+  PUT(PREV_PTR(arena->heap_start), PACK(0, ALLOC));
+  PUT(arena->heap_start, PREV_ALLOC);
+  PUT(arena->heap_end, PACK(0, ALLOC));
+  set_tags(arena->heap_start, arena->heap_end - arena->heap_start, FREE);
+  arena->zero = arena->heap_start;
+
+  fl_insert(arena->heap_start);
+}
+
+void mm_init(FreelistPolicy fp)
+{
+  LOG(1, "mm_init()");
+
+  //
+  // set free list policy
+  //
+  // the placement policy only applies to the implicit and explicit lists; the other policies
+  // keep their lists unordered (LIFO)
+  freelist_policy = fp;
+  placement = pp_BestFit;
+  switch (freelist_policy)
+  {
+    case fp_Implicit:
+      placement = placement_next;
+      get_free_block = placements[placement].implicit;
+      break;
+
+    case fp_Explicit:
+    case fp_QuickFit:
+      placement = placement_next;
+      get_free_block = placements[placement].explicit;
+      break;
+
+    case fp_Segregated:
+      get_free_block = bf_get_free_block_segregated;
+      break;
+
+    case fp_Tree:
+      get_free_block = bf_get_free_block_tree;
+      break;
+
+    case fp_TLSF:
+      get_free_block = gf_get_free_block_tlsf;
+      break;
+
+    default:
+      PANIC("Non supported freelist policy.");
+      break;
+  }
+
+  //
+  // retrieve heap status and perform a few initial sanity checks
+  //
+  void *ds_heap_start, *ds_heap_brk, *ds_heap_end;
+  ds_heap_stat(&ds_heap_start, &ds_heap_brk, &ds_heap_end);
+  PAGESIZE = ds_getpagesize();
+
+  LOG(2, "  ds_heap_start:          %p\n"
+         "  ds_heap_brk:            %p\n"
+         "  PAGESIZE:               %d\n",
+         ds_heap_start, ds_heap_brk, PAGESIZE);
+
+  if (ds_heap_start == NULL) PANIC("Data segment not initialized.");
+  if (ds_heap_start != ds_heap_brk) PANIC("Heap not clean.");
+  if (PAGESIZE == 0) PANIC("Reported pagesize == 0.");
+#ifdef COMPACT_TAGS
+  if (ds_heap_end - ds_heap_start > (1L<<32) - BS) PANIC("Data segment too large for 32-bit tags.");
+#endif
+
+  //
+  // initialize arenas. Arena 0 uses the data segment provided by the caller, the others get
+  // data segments of the same size.
+  //
+  narenas = narenas_next;
+  mm_generation++;
+
+  for (int i = 0; i < narenas; i++) {
+    int seg = i == 0 ? 0 : ds_allocate_seg(ds_heap_end - ds_heap_start);
+    if (seg < 0) PANIC("Cannot allocate data segment for arena.");
+
+    arena_init(&arenas[i], seg);
+  }
+  arena = &arenas[0];
+
+  //
+  // heap is initialized
+  //
+  mm_initialized = 1;
+}
+
+
+/// @brief find and return a free block of at least @a size bytes (best fit)
+/// @param size size of block (including header & footer tags), in bytes
+/// @retval void* pointer to header of large enough free block
+/// @retval NULL if no free block of the requested size is avilable
+static void* bf_get_free_block_implicit(size_t size)
+{
+  LOG(1, "bf_get_free_block_implicit(0x%lx (%lu))", size, size);
+
+  assert(mm_initialized);
+
+  void *best = NULL;
+  size_t best_size = 0;
+
+  for (void *p = arena->heap_start; p < arena->heap_end; p = NEXT_BLK(p)) {
+    TYPE hdr = GET(p);
+    size_t bsize = SIZE(hdr);
+
+    if ((STATUS(hdr) == FREE) && (bsize >= size) && ((best == NULL) || (bsize < best_size))) {
+      best = p;
+      best_size = bsize;
+      if (bsize == size) break;
+    }
+  }
+
+  return best;
+}
+
+
+/// @brief find and return a free block of at least @a size bytes (best fit)
+/// @param size size of block (including header & footer tags), in bytes
+/// @retval void* pointer to header of large enough free block
+/// @retval NULL if no free block of the requested size is avilable
+static void* bf_get_free_block_explicit(size_t size)
+{
+  LOG(1, "bf_get_free_block_explicit(0x%lx (%lu))", size, size);
+
+  assert(mm_initialized);
+
+  void *best = NULL;
+  size_t best_size = 0;
+
+  for (void *p = arena->free_list; p != NULL; p = NEXT_LIST_GET(p)) {
+    size_t bsize = GET_SIZE(p);
+
+    if ((bsize >= size) && ((best == NULL) || (bsize < best_size))) {
+      best = p;
+      best_size = bsize;
+      if (bsize == size) break;
+    }
+  }
+
+  return best;
+}
+
+
+/// @brief find and return the first free block of at least @a size bytes (first fit)
+/// @param size size of block (including header & footer tags), in bytes
+/// @retval void* pointer to header of large enough free block
+/// @retval NULL if no free block of the requested size is avilable
+static void* ff_get_free_block_implicit(size_t size)
+{
+  LOG(1, "ff_get_free_block_implicit(0x%lx (%lu))", size, size);
+
+  assert(mm_initialized);
+
+  for (void *p = arena->heap_start; p < arena->heap_end; p = NEXT_BLK(p)) {
+    TYPE hdr = GET(p);
+    if ((STATUS(hdr) == FREE) && (SIZE(hdr) >= size)) return p;
+  }
+
+  return NULL;
+}
+
+
+/// @brief find and return the first free block of at least @a size bytes (first fit)
+/// @param size size of block (including header & footer tags), in bytes
+/// @retval void* pointer to header of large enough free block
+/// @retval NULL if no free block of the requested size is avilable
+static void* ff_get_free_block_explicit(size_t size)
+{
+  LOG(1, "ff_get_free_block_explicit(0x%lx (%lu))", size, size);
+
+  assert(mm_initialized);
+
+  for (void *p = arena->free_list; p != NULL; p = NEXT_LIST_GET(p)) {
+    if (GET_SIZE(p) >= size) return p;
+  }
+
+  return NULL;
+}
+
+
+/// @brief find and return the first free block of at least @a size bytes, starting at the
+///        rover and wrapping around at the end of the heap (next fit)
+/// @param size size of block (including header & footer tags), in bytes
+/// @retval void* pointer to header of large enough free block
+/// @retval NULL if no free block of the requested size is avilable
+static void* nf_get_free_block_implicit(size_t size)
+{
+  LOG(1, "nf_get_free_block_implicit(0x%lx (%lu))", size, size);
+
+  assert(mm_initialized);
+
+  void *start = arena->rover;
+  if ((start == NULL) || (start >= arena->heap_end)) start = arena->heap_start;
+
+  void *p = start;
+  do {
+    TYPE hdr = GET(p);
+    if ((STATUS(hdr) == FREE) && (SIZE(hdr) >= size)) {
+      arena->rover = p;
+      return p;
+    }
+
+    p = NEXT_BLK(p);
+    if (p >= arena->heap_end) p = arena->heap_start;
+  } while (p != start);
+
+  return NULL;
+}
+
+
+/// @brief find and return the first free block of at least @a size bytes, starting at the
+///        rover and wrapping around at the end of the list (next fit)
+/// @param size size of block (including header & footer tags), in bytes
+/// @retval void* pointer to header of large enough free block
+/// @retval NULL if no free block of the requested size is avilable
+static void* nf_get_free_block_explicit(size_t size)
+{
+  LOG(1, "nf_get_free_block_explicit(0x%lx (%lu))", size, size);
+
+  assert(mm_initialized);
+
+  void *start = arena->rover != NULL ? arena->rover : arena->free_list;
+  if (start == NULL) return NULL;
+
+  void *p = start;
+  do {
+    if (GET_SIZE(p) >= size) {
+      // fl_remove() advances the rover past the block once it is allocated
+      arena->rover = p;
+      return p;
+    }
+
+    p = NEXT_LIST_GET(p);
+    if (p == NULL) p = arena->free_list;
+  } while (p != start);
+
+  return NULL;
+}
+
+
+/// @brief find and return the first free block of at least @a size and at most @a size plus
+///        mm_goodfit percent bytes, or the best fit if there is none (good fit)
+/// @param size size of block (including header & footer tags), in bytes
+/// @retval void* pointer to header of large enough free block
+/// @retval NULL if no free block of the requested size is avilable
+static void* gf_get_free_block_implicit(size_t size)
+{
+  LOG(1, "gf_get_free_block_implicit(0x%lx (%lu))", size, size);
+
+  assert(mm_initialized);
+
+  size_t good = size + size / 100 * mm_goodfit;
+  void *best = NULL;
+  size_t best_size = 0;
+
+  for (void *p = arena->heap_start; p < arena->heap_end; p = NEXT_BLK(p)) {
+    TYPE hdr = GET(p);
+    size_t bsize = SIZE(hdr);
+
+    if ((STATUS(hdr) == FREE) && (bsize >= size) && ((best == NULL) || (bsize < best_size))) {
+      best = p;
+      best_size = bsize;
+      if (bsize <= good) break;
+    }
+  }
+
+  return best;
+}
+
+
+/// @brief find and return the first free block of at least @a size and at most @a size plus
+///        mm_goodfit percent bytes, or the best fit if there is none (good fit)
+/// @param size size of block (including header & footer tags), in bytes
+/// @retval void* pointer to header of large enough free block
+/// @retval NULL if no free block of the requested size is avilable
+static void* gf_get_free_block_explicit(size_t size)
+{
+  LOG(1, "gf_get_free_block_explicit(0x%lx (%lu))", size, size);
+
+  assert(mm_initialized);
+
+  size_t good = size + size / 100 * mm_goodfit;
+  void *best = NULL;
+  size_t best_size = 0;
+
+  for (void *p = arena->free_list; p != NULL; p = NEXT_LIST_GET(p)) {
+    size_t bsize = GET_SIZE(p);
+
+    if ((bsize >= size) && ((best == NULL) || (bsize < best_size))) {
+      best = p;
+      best_size = bsize;
+      if (bsize <= good) break;
+    }
+  }
+
+  return best;
+}
+
+
+/// @brief find and return a free block of at least @a size bytes (best fit over size classes)
+/// @param size size of block (including header & footer tags), in bytes
+/// @retval void* pointer to header of large enough free block
+/// @retval NULL if no free block of the requested size is avilable
+static void* bf_get_free_block_segregated(size_t size)
+{
+  LOG(1, "bf_get_free_block_segregated(0x%lx (%lu))", size, size);
+
+  assert(mm_initialized);
+
+  for (int c = seg_class(size); c < SEG_NUM; c++) {
+    if (arena->seg_list[c] == NULL) continue;
+
+    // all blocks in an exact class have the same size and fit
+    if (c < SEG_EXACT) return arena->seg_list[c];
+
+    void *best = NULL;
+    size_t best_size = 0;
+
+    for (void *p = arena->seg_list[c]; p != NULL; p = NEXT_LIST_GET(p)) {
+      size_t bsize = GET_SIZE(p);
+
+      if ((bsize >= size) && ((best == NULL) || (bsize < best_size))) {
+        best = p;
+        best_size = bsize;
+        if (bsize == size) break;
+      }
+    }
+
+    if (best != NULL) return best;
+  }
+
+  return NULL;
+}
+
+
+/// @brief find and return a free block of at least @a size bytes (best fit by tree lookup)
+/// @param size size of block (including header & footer tags), in bytes
+/// @retval void* pointer to header of large enough free block
+/// @retval NULL if no free block of the requested size is avilable
+static void* bf_get_free_block_tree(size_t size)
+{
+  LOG(1, "bf_get_free_block_tree(0x%lx (%lu))", size, size);
+
+  assert(mm_initialized);
+
+  void *best = NULL;
+  void *p = UNLINK(arena->free_tree);
+
+  while (p != NULL) {
+    if (GET_SIZE(p) >= size) {
+      best = p;
+      if (GET_SIZE(p) == size) break;
+      p = TREE_GET(TREE_LEFT(p));
+    } else {
+      p = TREE_GET(TREE_RIGHT(p));
+    }
+  }
+
+  return best;
+}
+
+
+/// @brief find and return a free block of at least @a size bytes (good fit, constant time)
+/// @param size size of block (including header & footer tags), in bytes
+/// @retval void* pointer to header of large enough free block
+/// @retval NULL if no free block of the requested size is avilable
+static void* gf_get_free_block_tlsf(size_t size)
+{
+  LOG(1, "gf_get_free_block_tlsf(0x%lx (%lu))", size, size);
+
+  assert(mm_initialized);
+
+  // round up to the next second-level boundary so that any block of the found list fits
+  int fl, sl;
+  tlsf_mapping(size, &fl, &sl);
+  size += (1UL << (fl - TLSF_SL_LOG2)) - 1;
+  tlsf_mapping(size, &fl, &sl);
+
+  unsigned int sl_map = arena->tlsf_sl_bitmap[fl] & (~0U << sl);
+  if (sl_map == 0) {
+    unsigned long fl_map = fl+1 < TLSF_FL ? arena->tlsf_fl_bitmap & (~0UL << (fl+1)) : 0;
+    if (fl_map == 0) return NULL;
+
+    fl = __builtin_ctzl(fl_map);
+    sl_map = arena->tlsf_sl_bitmap[fl];
+  }
+  sl = __builtin_ctz(sl_map);
+
+  return arena->tlsf_list[fl][sl];
+}
+
+
+/// @name Heap operations
+/// @{
+
+/// @brief allocate a payload of @a size bytes from the shared heap. Callers hold the heap lock.
+/// @param size payload size in bytes (> 0)
+/// @retval void* pointer to payload
+/// @retval NULL if the request cannot be satisfied
+static void* heap_malloc(size_t size)
+{
+  if (mm_slab && (size <= SLAB_MAX)) return slab_alloc(size);
+
+  size_t bsize = block_size(size);
+  if (bsize == 0) return NULL;
+
+  if ((freelist_policy == fp_QuickFit) && (bsize <= QUICK_LIMIT)) {
+    void *blk = quick_pop(bsize);
+    if (blk != NULL) return NEXT_PTR(blk);
+  }
+
+  void *blk = find_block(bsize);
+  if (blk == NULL) return NULL;
+
+  place(blk, bsize);
+
+  return NEXT_PTR(blk);
+}
+
+/// @brief release payload @a ptr to the shared heap. Callers hold the heap lock.
+/// @param ptr pointer to payload (not NULL)
+static void heap_free(void *ptr)
+{
+  if (IS_SLAB_OBJ(ptr)) {
+    slab_free(ptr);
+    return;
+  }
+
+  void *blk = BLOCK_OF(ptr);
+
+  if (GET_STATUS(blk) != ALLOC) {
+    fprintf(stderr, "ERROR: mm_free(%p): block is not allocated.\n", ptr);
+    return;
+  }
+
+  //
+  // defer coalescing of small blocks until a request misses or the quick lists grow too large
+  //
+  if ((freelist_policy == fp_QuickFit) && (GET_SIZE(blk) <= QUICK_LIMIT)) {
+    quick_push(blk);
+    if (arena->quick_bytes > QUICK_THLD) quick_consolidate();
+    return;
+  }
+
+  free_block(blk);
+}
+
+/// @brief allocate @a n payloads of @a size bytes from the shared heap. Regular blocks are carved
+///        from one free block of @a n times the block size if possible; slab objects and blocks
+///        that cannot be carved are allocated one by one. Callers hold the heap lock.
+/// @param size payload size in bytes (> 0)
+/// @param n number of payloads
+/// @param out array receiving the payloads
+/// @retval size_t number of payloads allocated (< @a n if the data segment is exhausted)
+static size_t heap_malloc_batch(size_t size, size_t n, void **out)
+{
+  size_t bsize = block_size(size);
+  size_t i = 0;
+
+  if (!(mm_slab && (size <= SLAB_MAX)) && (bsize > 0) && (n > 1) && (n <= SIZE_MASK/bsize)) {
+    void *blk = get_free_block(n*bsize);
+
+    if (blk != NULL) {
+      fl_remove(blk);
+
+      size_t rest = GET_SIZE(blk);
+      for (; i < n-1; i++) {
+        set_tags(blk, bsize, ALLOC);
+        out[i] = NEXT_PTR(blk);
+        blk += bsize;
+        rest -= bsize;
+      }
+
+      // the last block takes the remainder and returns it to the free list
+      carve(blk, rest, bsize);
+      out[i++] = NEXT_PTR(blk);
+    }
+  }
+
+  for (; i < n; i++) {
+    if ((out[i] = heap_malloc(size)) == NULL) break;
+  }
+
+  return i;
+}
+
+/// @brief release the payload @a ptrs[0] and the following payloads whose blocks are its direct
+///        successors in the heap. The blocks of such a run are merged into one allocated block
+///        that is then freed (and coalesced) once. Callers hold the heap lock.
+/// @param ptrs payloads sorted by address (not NULL, not mapped, all in the current arena)
+/// @param n number of payloads
+/// @retval size_t number of payloads released
+static size_t heap_free_run(void **ptrs, size_t n)
+{
+  void *ptr = ptrs[0];
+  if (!IS_REGULAR_OBJ(ptr) || (GET_STATUS(PREV_PTR(ptr)) != ALLOC)) {
+    heap_free(ptr);
+    return 1;
+  }
+
+  // runs consist of regular blocks only; heap_free releases slab objects and aligned payloads
+  void *blk = PREV_PTR(ptr);
+  size_t size = GET_SIZE(blk);
+  size_t i = 1;
+
+  while ((i < n) && (ptrs[i] == NEXT_PTR(blk + size)) && (GET_STATUS(blk + size) == ALLOC)) {
+    size += GET_SIZE(blk + size);
+    i++;
+  }
+
+  if (i == 1) heap_free(ptr);
+  else {
+    set_tags(blk, size, ALLOC);
+    free_block(blk);
+  }
+
+  return i;
+}
+
+/// @brief clear the first @a size bytes of the payload @a ptr of a newly allocated heap block.
+///        Memory at and above @a zero, the arena's zero mark before the allocation, is known to be
+///        zero except for the header and links of a free block at the zero mark, the links of
+///        the free block @a ptr was taken from, and (with ELIDE_FOOTER) its footer.
+/// @param ptr pointer to payload of regular block (not a slab object)
+/// @param size number of bytes to clear
+/// @param zero zero mark before the allocation
+static void clear_payload(void *ptr, size_t size, void *zero)
+{
+  void *end = ptr + size;
+  void *dirty = MIN(end, MAX(zero + 3*TYPE_SIZE, ptr + 2*TYPE_SIZE));
+
+  memset(ptr, 0, dirty - ptr);
+
+  void *last = NEXT_BLK(PREV_PTR(ptr)) - TYPE_SIZE;
+  if (end > MAX(last, dirty)) memset(MAX(last, dirty), 0, end - MAX(last, dirty));
+}
+
+/// @brief resize payload @a ptr to @a size bytes. Callers hold the heap lock.
+/// @param ptr pointer to payload (not NULL)
+/// @param size new payload size in bytes (> 0)
+/// @retval void* pointer to resized payload
+/// @retval NULL if the request cannot be satisfied (@a ptr remains valid)
+static void* heap_realloc(void *ptr, size_t size)
+{
+  //
+  // slab objects stay in place if the size class does not change, otherwise they move.
+  // Aligned payloads shrink in place and keep their alignment; when growing, they move to a
+  // regular block (realloc() does not preserve alignments beyond the natural one).
+  //
+  if (IS_SLAB_OBJ(ptr)) {
+    size_t osize = SLAB_OF(ptr)->osize;
+    if ((size <= osize) && (size > osize - SLAB_ALIGN)) return ptr;
+
+    void *payload = heap_malloc(size);
+    if (payload == NULL) return NULL;
+
+    memcpy(payload, ptr, MIN(osize, size));
+    slab_free(ptr);
+
+    return payload;
+  }
+
+  if (!IS_REGULAR_OBJ(ptr)) {
+    void *blk = ptr - ALIGN_HDR_OFS;
+    size_t avail = aligned_size(ptr);
+    size_t bsize = aligned_block_size(size);
+
+    if ((bsize > 0) && (bsize <= GET_SIZE(blk))) {
+      split(blk, bsize);
+      return ptr;
+    }
+
+    void *payload = heap_malloc(size);
+    if (payload == NULL) return NULL;
+
+    memcpy(payload, ptr, MIN(avail, size));
+    heap_free(ptr);
+
+    return payload;
+  }
+
+  void *blk = PREV_PTR(ptr);
+  size_t bsize = block_size(size);
+  size_t cur = GET_SIZE(blk);
+
+  if (bsize == 0) return NULL;
+
+  //
+  // shrink in place
+  //
+  if (bsize <= cur) {
+    split(blk, bsize);
+    return ptr;
+  }
+
+  //
+  // at the end of the heap, extend the heap so that the free successor suffices
+  //
+  void *next = NEXT_BLK(blk);
+  size_t nsize = GET_STATUS(next) == FREE ? GET_SIZE(next) : 0;
+  if ((cur + nsize < bsize) && (next + nsize == arena->heap_end) && (extend_heap(bsize - cur) != NULL)) {
+    next = NEXT_BLK(blk);
+    nsize = GET_SIZE(next);
+  }
+
+  //
+  // grow in place by merging with a free successor
+  //
+  if (cur + nsize >= bsize) {
+    fl_remove(next);
+    set_tags(blk, cur + nsize, ALLOC);
+    split(blk, bsize);
+    return ptr;
+  }
+
+  //
+  // grow by merging with a free predecessor (and successor); the payload moves down within the
+  // merged block. Holes more than twice the requested size are left to other requests.
+  //
+  if (prev_free(blk)) {
+    void *prev = PREV_BLK(blk);
+    size_t psize = GET_SIZE(prev);
+
+    if ((psize + cur + nsize >= bsize) && (psize + cur + nsize <= 2*bsize)) {
+      fl_remove(prev);
+      if (nsize > 0) fl_remove(next);
+
+      void *payload = NEXT_PTR(prev);
+      memmove(payload, ptr, cur - ALLOC_OVERHEAD);
+      set_tags(prev, psize + cur + nsize, ALLOC);
+      split(prev, bsize);
+
+      return payload;
+    }
+  }
+
+  //
+  // allocate, copy, and free
+  //
+  void *payload = heap_malloc(size);
+  if (payload == NULL) return NULL;
+
+  memcpy(payload, ptr, cur - ALLOC_OVERHEAD);
+  heap_free(ptr);
+
+  return payload;
+}
+
+/// @}
+
+
+/// @name Arena management
+/// @{
+
+/// @brief return the arena assigned to the calling thread
+static inline Arena* arena_of_thread(void)
+{
+  if (narenas == 1) return &arenas[0];
+
+  if (arena_assign == aa_CPU) {
+    int cpu = sched_getcpu();
+    return &arenas[(cpu < 0 ? 0 : cpu) % narenas];
+  }
+
+  if ((arena_home == NULL) || (arena_gen != mm_generation)) {
+    arena_home = &arenas[__atomic_fetch_add(&arena_rr, 1, __ATOMIC_RELAXED) % narenas];
+    arena_gen = mm_generation;
+  }
+
+  return arena_home;
+}
+
+/// @brief return the arena whose data segment contains @a ptr
+static inline Arena* arena_of(void *ptr)
+{
+  for (int i = 1; i < narenas; i++) {
+    if ((ptr >= arenas[i].ds_heap_start) && (ptr < arenas[i].ds_heap_end)) return &arenas[i];
+  }
+
+  return &arenas[0];
+}
+
+/// @}
+
+
+/// @name Mapped blocks
+/// @{
+
+/// @brief check whether @a ptr is the payload of a mapped block
+static inline int is_mapped(void *ptr)
+{
+  if ((WORD(ptr) & (PAGESIZE-1)) != MMAP_OFS) return 0;
+
+  for (int i = 0; i < narenas; i++) {
+    if ((ptr >= arenas[i].ds_heap_start) && (ptr < arenas[i].ds_heap_end)) return 0;
+  }
+
+  return 1;
+}
+
+/// @brief allocate a mapped block of @a size bytes
+/// @param size payload size in bytes
+/// @retval void* pointer to payload
+/// @retval NULL if the request cannot be satisfied
+static void* map_alloc(size_t size)
+{
+  if (size > SIZE_MAX - MMAP_OFS - PAGESIZE) return NULL;
+
+  size_t rsize = ROUND_UP(size + MMAP_OFS, PAGESIZE);
+  void *region = ds_map_region(rsize);
+  if (region == NULL) return NULL;
+
+  void *ptr = region + MMAP_OFS;
+  MMAP_SIZE(ptr) = rsize;
+  PUT(PREV_PTR(ptr), PACK(0, ALLOC));
+
+  LOG(2, "  mapped block %p (region size 0x%lx)", ptr, rsize);
+
+  return ptr;
+}
+
+/// @brief resize the mapped block @a ptr to @a size bytes by remapping its region
+/// @param ptr pointer to payload of mapped block
+/// @param size new payload size in bytes
+/// @retval void* pointer to payload (may differ from @a ptr)
+/// @retval NULL if the region cannot be remapped (@a ptr remains valid)
+static void* map_realloc(void *ptr, size_t size)
+{
+  if (size > SIZE_MAX - MMAP_OFS - PAGESIZE) return NULL;
+
+  size_t rsize = ROUND_UP(size + MMAP_OFS, PAGESIZE);
+  void *region = ds_remap_region(ptr - MMAP_OFS, MMAP_SIZE(ptr), rsize);
+  if (region == NULL) return NULL;
+
+  ptr = region + MMAP_OFS;
+  MMAP_SIZE(ptr) = rsize;
+
+  LOG(2, "  remapped block %p (region size 0x%lx)", ptr, rsize);
+
+  return ptr;
+}
+
+/// @brief unmap the mapped block @a ptr
+static void map_free(void *ptr)
+{
+  ds_unmap_region(ptr - MMAP_OFS, MMAP_SIZE(ptr));
+}
+
+/// @brief return the usable payload size of the allocated object @a ptr. Needs no lock, the size
+///        of an allocated object only changes through its owner.
+static size_t payload_size(void *ptr)
+{
+  if (is_mapped(ptr)) return MMAP_SIZE(ptr) - MMAP_OFS;
+  if (IS_SLAB_OBJ(ptr)) return SLAB_OF(ptr)->osize;
+  if (!IS_REGULAR_OBJ(ptr)) return aligned_size(ptr);
+  return GET_SIZE(PREV_PTR(ptr)) - ALLOC_OVERHEAD;
+}
+
+/// @}
+
+
+#ifdef MM_THREADS
+/// @name Remote frees
+/// @{
+
+/// @brief free the objects on the remote stack of the current arena. Callers hold its lock.
+static void remote_drain(void)
+{
+  if (__atomic_load_n(&arena->remote, __ATOMIC_RELAXED) == NULL) return;
+
+  void *ptr = __atomic_exchange_n(&arena->remote, NULL, __ATOMIC_ACQUIRE);
+  long n = 0;
+
+  while (ptr != NULL) {
+    void *next = *(void**)ptr;
+    heap_free(ptr);
+    ptr = next;
+    n++;
+  }
+
+  __atomic_sub_fetch(&arena->nremote, n, __ATOMIC_RELAXED);
+}
+
+/// @brief push @a ptr onto the remote stack of arena @a a without taking its lock
+/// @param a arena containing @a ptr
+/// @param ptr pointer to payload (not NULL)
+static void remote_free(Arena *a, void *ptr)
+{
+  void *head = __atomic_load_n(&a->remote, __ATOMIC_RELAXED);
+  do {
+    *(void**)ptr = head;
+  } while (!__atomic_compare_exchange_n(&a->remote, &head, ptr, 1, __ATOMIC_RELEASE,
+                                        __ATOMIC_RELAXED));
+
+  // drain a long queue on behalf of the owner unless the owner is busy with the arena
+  if ((__atomic_add_fetch(&a->nremote, 1, __ATOMIC_RELAXED) >= REMOTE_THLD) &&
+      (pthread_mutex_trylock(&a->lock) == 0)) {
+    Arena *cur = arena;
+    arena = a;
+    remote_drain();
+    UNLOCK(a);
+    arena = cur;
+  }
+}
+
+/// @}
+
+
+/// @name Thread caches
+/// @{
+
+/// @brief return the thread cache class of a request of @a size bytes
+/// @param size payload size in bytes (> 0)
+/// @retval int class
+/// @retval -1 if requests of this size are not cached
+static inline int tc_class(size_t size)
+{
+  if (mm_slab && (size <= SLAB_MAX)) return (size - 1) / SLAB_ALIGN;
+
+  size_t bsize = block_size(size);
+  if ((bsize == 0) || (bsize > TCACHE_LIMIT)) return -1;
+
+  return SLAB_CLASSES + bsize/BS - 1;
+}
+
+/// @brief return the thread cache class of the allocated object @a ptr
+/// @param ptr pointer to payload (not NULL)
+/// @retval int class
+/// @retval -1 if the object is not cached
+static inline int tc_class_of(void *ptr)
+{
+  if (IS_SLAB_OBJ(ptr)) return SLAB_OF(ptr)->cls;
+  if (!IS_REGULAR_OBJ(ptr)) return -1;
+
+  // the size of an allocated block only changes through its owner
+  void *blk = PREV_PTR(ptr);
+  if ((GET_STATUS(blk) != ALLOC) || (GET_SIZE(blk) > TCACHE_LIMIT)) return -1;
+
+  return SLAB_CLASSES + GET_SIZE(blk)/BS - 1;
+}
+
+/// @brief return @a n objects of class @a cls from thread cache @a tc to their arenas. The lock
+///        of an arena is held while consecutive objects belong to it.
+static void tc_flush(TCache *tc, int cls, unsigned int n)
+{
+  Arena *home = arena_of_thread();
+  Arena *locked = NULL;
+
+  while ((n-- > 0) && (tc->list[cls] != NULL)) {
+    void *ptr = tc->list[cls];
+    tc->list[cls] = *(void**)ptr;
+    tc->count[cls]--;
+
+    arena = arena_of(ptr);
+    if (mm_remote && (arena != home)) {
+      remote_free(arena, ptr);
+      continue;
+    }
+
+    if (arena != locked) {
+      if (locked != NULL) UNLOCK(locked);
+      LOCK(arena);
+      locked = arena;
+    }
+    heap_free(ptr);
+  }
+
+  if (locked != NULL) UNLOCK(locked);
+}
+
+/// @brief release the cache of an exiting thread (pthread key destructor)
+/// @param arg thread cache
+static void tc_destroy(void *arg)
+{
+  TCache *tc = arg;
+
+  if (tc->gen == mm_generation) {
+    for (int c = 0; c < TCACHE_CLASSES; c++) tc_flush(tc, c, TCACHE_DEPTH);
+  }
+}
+
+/// @brief create the pthread key that flushes thread caches on thread exit
+static void tc_key_create(void)
+{
+  pthread_key_create(&tcache_key, tc_destroy);
+}
+
+/// @brief return the calling thread's cache. Objects cached before the heap was re-initialized
+///        are dropped.
+static inline TCache* tc_get(void)
+{
+  if (tcache.gen != mm_generation) {
+    memset(&tcache, 0, sizeof(tcache));
+    tcache.gen = mm_generation;
+
+    pthread_once(&tcache_once, tc_key_create);
+    pthread_setspecific(tcache_key, &tcache);
+  }
+
+  return &tcache;
+}
+
+/// @brief allocate an object of class @a cls for the caller and refill thread cache @a tc with
+///        up to TCACHE_BATCH-1 more. Callers hold the heap lock.
+/// @param size payload size in bytes
+/// @retval void* pointer to payload
+/// @retval NULL if the request cannot be satisfied
+static void* tc_refill(TCache *tc, int cls, size_t size)
+{
+  void *ptr = heap_malloc(size);
+
+  for (int i = 1; (ptr != NULL) && (i < TCACHE_BATCH) && (tc->count[cls] < TCACHE_DEPTH); i++) {
+    void *p = heap_malloc(size);
+    if (p == NULL) break;
+
+    *(void**)p = tc->list[cls];
+    tc->list[cls] = p;
+    tc->count[cls]++;
+  }
+
+  return ptr;
+}
+
+/// @}
+#endif
+
+
+void* mm_malloc(size_t size)
+{
+  LOG(1, "mm_malloc(0x%lx (%lu))", size, size);
+
+  assert(mm_initialized);
+
+  if (size == 0) return NULL;
+  if ((mm_mmap_thld > 0) && (size >= mm_mmap_thld)) return map_alloc(size);
+
+  arena = arena_of_thread();
+
+#ifdef MM_THREADS
+  int cls = mm_tcache ? tc_class(size) : -1;
+  if (cls >= 0) {
+    TCache *tc = tc_get();
+    void *ptr = tc->list[cls];
+
+    if (ptr != NULL) {
+      tc->list[cls] = *(void**)ptr;
+      tc->count[cls]--;
+      return ptr;
+    }
+
+    LOCK(arena);
+    remote_drain();
+    ptr = tc_refill(tc, cls, size);
+    UNLOCK(arena);
+
+    return ptr;
+  }
+#endif
+
+  LOCK(arena);
+#ifdef MM_THREADS
+  remote_drain();
+#endif
+  void *ptr = heap_malloc(size);
+  UNLOCK(arena);
+
+  return ptr;
+}
+
+
+void* mm_calloc(size_t nmemb, size_t size)
+{
+  LOG(1, "mm_calloc(0x%lx, 0x%lx (%lu))", nmemb, size, size);
+
+  assert(mm_initialized);
+
+  if ((size > 0) && (nmemb > SIZE_MAX / size)) return NULL;
+  size *= nmemb;
+
+  //
+  // mapped blocks come straight from mmap() and are zero. Small requests (thread caches, slabs)
+  // are simply cleared.
+  //
+  if ((mm_mmap_thld > 0) && (size >= mm_mmap_thld)) return map_alloc(size);
+
+  if (size < (size_t)PAGESIZE) {
+    void *payload = mm_malloc(size);
+    if (payload != NULL) memset(payload, 0, size);
+    return payload;
+  }
+
+  //
+  // larger blocks only need to be cleared below the arena's zero mark
+  //
+  arena = arena_of_thread();
+
+  LOCK(arena);
+#ifdef MM_THREADS
+  remote_drain();
+#endif
+  void *zero = arena->zero;
+  void *payload = heap_malloc(size);
+  UNLOCK(arena);
+
+  if (payload != NULL) clear_payload(payload, size, zero);
+
+  return payload;
+}
+
+
+void* mm_aligned_alloc(size_t alignment, size_t size)
+{
+  LOG(1, "mm_aligned_alloc(0x%lx, 0x%lx (%lu))", alignment, size, size);
+
+  assert(mm_initialized);
+
+  if ((alignment == 0) || ((alignment & (alignment-1)) != 0)) return NULL;
+  if (alignment <= MM_ALIGN) return mm_malloc(size);
+  if (size == 0) return NULL;
+
+  arena = arena_of_thread();
+
+  LOCK(arena);
+#ifdef MM_THREADS
+  remote_drain();
+#endif
+  void *ptr = aligned_alloc_block(size, alignment);
+  UNLOCK(arena);
+
+  return ptr;
+}
+
+
+int mm_posix_memalign(void **memptr, size_t alignment, size_t size)
+{
+  if ((alignment < sizeof(void*)) || ((alignment & (alignment-1)) != 0)) return EINVAL;
+
+  void *ptr = mm_aligned_alloc(alignment, size);
+  if ((ptr == NULL) && (size > 0)) return ENOMEM;
+
+  *memptr = ptr;
+  return 0;
+}
+
+
+void* mm_memalign(size_t alignment, size_t size)
+{
+  return mm_aligned_alloc(alignment, size);
+}
+
+
+void* mm_realloc(void *ptr, size_t size)
+{
+  LOG(1, "mm_realloc(%p, 0x%lx (%lu))", ptr, size, size);
+
+  assert(mm_initialized);
+
+  if (ptr == NULL) return mm_malloc(size);
+  if (size == 0) {
+    mm_free(ptr);
+    return NULL;
+  }
+
+  //
+  // mapped blocks stay in place unless they would waste more than half of their region, else
+  // their region is remapped; blocks crossing the mapping threshold move between the heap and a
+  // region
+  //
+  int mapped = is_mapped(ptr);
+  int to_map = (mm_mmap_thld > 0) && (size >= mm_mmap_thld);
+
+  if (mapped || to_map) {
+    size_t avail = payload_size(ptr);
+    if (mapped && to_map) {
+      if ((size <= avail) && (size > avail/2)) return ptr;
+
+      void *payload = map_realloc(ptr, size);
+      if (payload != NULL) return payload;
+    }
+
+    void *payload = mm_malloc(size);
+    if (payload == NULL) return NULL;
+
+    memcpy(payload, ptr, MIN(avail, size));
+    mm_free(ptr);
+
+    return payload;
+  }
+
+  arena = arena_of(ptr);
+
+  LOCK(arena);
+  void *payload = heap_realloc(ptr, size);
+  UNLOCK(arena);
+
+  return payload;
+}
+
+
+void mm_free(void *ptr)
+{
+  LOG(1, "mm_free(%p)", ptr);
+
+  assert(mm_initialized);
+
+  if (ptr == NULL) return;
+
+  if (is_mapped(ptr)) {
+    map_free(ptr);
+    return;
+  }
+
+#ifdef MM_THREADS
+  int cls = mm_tcache ? tc_class_of(ptr) : -1;
+  if (cls >= 0) {
+    TCache *tc = tc_get();
+
+    *(void**)ptr = tc->list[cls];
+    tc->list[cls] = ptr;
+
+    // a full cache returns a batch of objects to the heap
+    if (++tc->count[cls] >= TCACHE_DEPTH) tc_flush(tc, cls, TCACHE_BATCH);
+    return;
+  }
+#endif
+
+  arena = arena_of(ptr);
+
+#ifdef MM_THREADS
+  if (mm_remote && (arena != arena_of_thread())) {
+    remote_free(arena, ptr);
+    return;
+  }
+#endif
+
+  LOCK(arena);
+  heap_free(ptr);
+  UNLOCK(arena);
+}
+
+
+size_t mm_malloc_batch(size_t size, size_t n, void **out)
+{
+  LOG(1, "mm_malloc_batch(0x%lx (%lu), %lu)", size, size, n);
+
+  assert(mm_initialized);
+
+  if (size == 0) return 0;
+
+  if ((mm_mmap_thld > 0) && (size >= mm_mmap_thld)) {
+    for (size_t i = 0; i < n; i++) {
+      if ((out[i] = map_alloc(size)) == NULL) return i;
+    }
+    return n;
+  }
+
+  arena = arena_of_thread();
+
+  LOCK(arena);
+#ifdef MM_THREADS
+  remote_drain();
+#endif
+  size_t nalloc = heap_malloc_batch(size, n, out);
+  UNLOCK(arena);
+
+  return nalloc;
+}
+
+
+/// @brief compare two pointers (qsort callback)
+static int cmp_ptr(const void *a, const void *b)
+{
+  uintptr_t x = WORD(*(void* const*)a), y = WORD(*(void* const*)b);
+  return (x > y) - (x < y);
+}
+
+void mm_free_batch(void **ptrs, size_t n)
+{
+  LOG(1, "mm_free_batch(%p, %lu)", ptrs, n);
+
+  assert(mm_initialized);
+
+  qsort(ptrs, n, sizeof(void*), cmp_ptr);
+
+  size_t i = 0;
+  while (i < n) {
+    void *ptr = ptrs[i];
+
+    if ((ptr == NULL) || is_mapped(ptr)) {
+      if (ptr != NULL) map_free(ptr);
+      i++;
+      continue;
+    }
+
+    arena = arena_of(ptr);
+
+#ifdef MM_THREADS
+    if (mm_remote && (arena != arena_of_thread())) {
+      remote_free(arena, ptr);
+      i++;
+      continue;
+    }
+#endif
+
+    //
+    // release the payloads of this arena under one lock, adjacent blocks as one run
+    //
+    Arena *a = arena;
+    size_t end = i + 1;
+    while ((end < n) && !is_mapped(ptrs[end]) && (arena_of(ptrs[end]) == a)) end++;
+
+    LOCK(a);
+    while (i < end) i += heap_free_run(&ptrs[i], end - i);
+    UNLOCK(a);
+  }
+}
+
+
+/// @brief allocate a chunk of @a size bytes for region @a r and link it into its chunk list
+/// @retval void* chunk (the first word holds the link)
+/// @retval NULL if memory allocation failed
+static void* region_chunk(Region *r, size_t size)
+{
+  void *chunk = mm_malloc(size);
+  if (chunk == NULL) return NULL;
+
+  *(void**)chunk = r->chunk;
+  r->chunk = chunk;
+
+  return chunk;
+}
+
+Region* mm_region_create(size_t chunk_size)
+{
+  LOG(1, "mm_region_create(0x%lx)", chunk_size);
+
+  assert(mm_initialized);
+
+  chunk_size = chunk_size ? MAX(chunk_size, REGION_MIN) : REGION_CHUNK;
+
+  void *chunk = mm_malloc(chunk_size);
+  if (chunk == NULL) return NULL;
+
+  *(void**)chunk = NULL;
+  Region *r = chunk + sizeof(void*);
+  r->chunk = chunk;
+  r->cur = PTR(ROUND_UP(WORD(r + 1), MM_ALIGN));
+  r->end = chunk + payload_size(chunk);
+  r->chunk_size = chunk_size;
+
+  return r;
+}
+
+
+void* mm_region_alloc(Region *r, size_t size)
+{
+  LOG(1, "mm_region_alloc(%p, 0x%lx (%lu))", r, size, size);
+
+  if ((size == 0) || (size > SIZE_MAX - r->chunk_size)) return NULL;
+  size = ROUND_UP(size, MM_ALIGN);
+
+  if (size > (size_t)(r->end - r->cur)) {
+    if (size > r->chunk_size/4) {
+      void *chunk = region_chunk(r, sizeof(void*) + size);
+      return chunk ? chunk + sizeof(void*) : NULL;
+    }
+
+    void *chunk = region_chunk(r, r->chunk_size);
+    if (chunk == NULL) return NULL;
+
+    r->cur = chunk + sizeof(void*);
+    r->end = chunk + payload_size(chunk);
+  }
+
+  void *ptr = r->cur;
+  r->cur += size;
+
+  return ptr;
+}
+
+
+void mm_region_destroy(Region *r)
+{
+  LOG(1, "mm_region_destroy(%p)", r);
+
+  if (r == NULL) return;
+
+  // the first chunk, which holds the descriptor, is the last one on the list
+  void *chunk = r->chunk;
+  while (chunk != NULL) {
+    void *next = *(void**)chunk;
+    mm_free(chunk);
+    chunk = next;
+  }
+}
+
+
+void mm_setloglevel(int level)
+{
+  mm_loglevel = level;
+}
+
+
+void mm_setslab(int active)
+{
+  mm_slab = (active > 0);
+}
+
+
+void mm_setplacement(PlacementPolicy pp)
+{
+  if ((pp < pp_BestFit) || (pp > pp_AddressOrdered)) PANIC("Non supported placement policy.");
+  placement_next = pp;
+}
+
+
+void mm_setgoodfit(unsigned int percent)
+{
+  mm_goodfit = percent;
+}
+
+
+void mm_setarenas(int n, ArenaAssignment assign)
+{
+  narenas_next = MAX(1, MIN(n, MM_MAXARENAS));
+  arena_assign = assign;
+}
+
+
+void mm_settcache(int active)
+{
+#ifdef MM_THREADS
+  mm_tcache = (active > 0);
+#else
+  (void)active;
+#endif
+}
+
+
+void mm_setmmapthld(size_t thld)
+{
+  mm_mmap_thld = thld;
+}
+
+
+void mm_setdecommit(size_t thld)
+{
+  mm_decommit_thld = thld;
+}
+
+
+void mm_setremotefree(int active)
+{
+#ifdef MM_THREADS
+  mm_remote = (active > 0);
+#else
+  (void)active;
+#endif
+}
+
+
+/// @brief recursively verify the free block tree rooted at @a node
+/// @param node subtree root
+/// @param lo all keys in the subtree must be greater than lo (NULL: no bound)
+/// @param hi all keys in the subtree must be less than hi (NULL: no bound)
+/// @param depth depth of @a node
+/// @param[out] height maximal depth encountered
+/// @param[out] errors incremented for every violation
+/// @retval long number of nodes in the subtree
+static long tree_check(void *node, void *lo, void *hi, int depth, int *height, long *errors)
+{
+  if (node == NULL) return 0;
+
+  if (depth > *height) *height = depth;
+
+  if ((node < arena->heap_start) || (node >= arena->heap_end) || (GET_STATUS(node) != FREE) ||
+      ((lo != NULL) && !TREE_LESS(lo, node)) || ((hi != NULL) && !TREE_LESS(node, hi))) {
+    (*errors)++;
+    printf("    --> ERROR: invalid tree node %p\n", node);
+    return 0;
+  }
+
+  void *l = TREE_GET(TREE_LEFT(node)), *r = TREE_GET(TREE_RIGHT(node));
+  if (((l != NULL) && (TREE_PRIO(l) > TREE_PRIO(node))) ||
+      ((r != NULL) && (TREE_PRIO(r) > TREE_PRIO(node)))) {
+    (*errors)++;
+    printf("    --> ERROR: tree node %p violates heap order\n", node);
+  }
+
+  return 1 + tree_check(l, lo, node, depth+1, height, errors)
+           + tree_check(r, node, hi, depth+1, height, errors);
+}
+
+
+/// @brief perform some sanity checks on the heap of the current arena and optionally dump it.
+///        Violations are always reported. Callers hold the arena lock.
+/// @param dump dump the heap (1) or only report violations (0)
+/// @retval long number of violations
+static long arena_check(int dump)
+{
+  void *p;
+
+  char *fpstr;
+  if (freelist_policy == fp_Implicit) fpstr = "Implicit";
+  else if (freelist_policy == fp_Explicit) fpstr = "Explicit";
+  else if (freelist_policy == fp_Segregated) fpstr = "Segregated";
+  else if (freelist_policy == fp_Tree) fpstr = "Tree";
+  else if (freelist_policy == fp_TLSF) fpstr = "TLSF";
+  else if (freelist_policy == fp_QuickFit) fpstr = "Quick lists";
+  else fpstr = "invalid";
+
+  if (dump) {
+    printf("----------------------------------------- mm_check ----------------------------------------------\n");
+    if (narenas > 1) printf("  arena:                  %ld of %d\n", arena - arenas, narenas);
+    printf("  ds_heap_start:          %p\n", arena->ds_heap_start);
+    printf("  ds_heap_brk:            %p\n", arena->ds_heap_brk);
+    printf("  heap_start:             %p\n", arena->heap_start);
+    printf("  heap_end:               %p\n", arena->heap_end);
+    printf("  free list policy:       %s\n", fpstr);
+    if ((freelist_policy == fp_Implicit) || (freelist_policy == fp_Explicit) ||
+        (freelist_policy == fp_QuickFit)) {
+      printf("  placement policy:       %s\n", placements[placement].name);
+    }
+
+    printf("\n");
+    p = PREV_PTR(arena->heap_start);
+    printf("  initial sentinel:       %p: size: %6lx (%7ld), status: %s\n",
+           p, GET_SIZE(p), GET_SIZE(p), GET_STATUS(p) == ALLOC ? "allocated" : "free");
+    p = arena->heap_end;
+    printf("  end sentinel:           %p: size: %6lx (%7ld), status: %s\n",
+           p, GET_SIZE(p), GET_SIZE(p), GET_STATUS(p) == ALLOC ? "allocated" : "free");
+#ifdef ELIDE_FOOTER
+    printf("  layout:                 footer elision (PREV_ALLOC in header)\n");
+#endif
+    printf("\n");
+
+    if(freelist_policy == fp_Implicit){
+      printf("    %-14s  %8s  %10s  %10s  %8s  %s\n", "address", "offset", "size (hex)", "size (dec)", "payload", "status");
+    }
+    else if (freelist_policy == fp_Tree) {
+      printf("    %-14s  %8s  %10s  %10s  %8s  %-14s  %-14s  %s\n", "address", "offset", "size (hex)", "size (dec)", "payload", "left", "right", "status");
+    }
+    else {
+      printf("    %-14s  %8s  %10s  %10s  %8s  %-14s  %-14s  %s\n", "address", "offset", "size (hex)", "size (dec)", "payload", "next", "prev", "status");
+    }
+  }
+
+  long errors = 0;
+  long nfree = 0;
+  long nquick = 0;
+#ifdef ELIDE_FOOTER
+  int prev_alloc = 1;
+#endif
+  p = arena->heap_start;
+  while (p < arena->heap_end) {
+    TYPE hdr = GET(p);
+    size_t size = SIZE(hdr);
+    TYPE status = STATUS(hdr);
+
+    if (dump) {
+      char *ofs_str, *size_str;
+      if (asprintf(&ofs_str, "0x%lx", p-arena->heap_start) < 0) ofs_str = NULL;
+      if (asprintf(&size_str, "0x%lx", size) < 0) size_str = NULL;
+
+      char *status_str = status == FREE ? "free" : status & SLAB ? "slab" :
+                         status & QUICK ? "quick" : "allocated";
+
+      if(freelist_policy == fp_Implicit){
+        printf("    %p  %8s  %10s  %10ld  %8ld  %s\n",
+                  p, ofs_str, size_str, size, size-(status == FREE ? 2*TYPE_SIZE : ALLOC_OVERHEAD), status_str);
+      }
+      else {
+        void *next = status != FREE ? NULL : NEXT_LIST_GET(p);
+        void *prev = status != FREE ? NULL : PREV_LIST_GET(p);
+
+        printf("    %p  %8s  %10s  %10ld  %8ld  %-14p  %-14p  %s\n",
+                  p, ofs_str, size_str, size, size-(status == FREE ? 2*TYPE_SIZE : ALLOC_OVERHEAD), next, prev, status_str);
+      }
+
+      free(ofs_str);
+      free(size_str);
+    }
+
+    if (p + size > arena->heap_end) {
+      errors++;
+      printf("    --> ERROR: block %p of size %lx overruns the end sentinel, aborting traversal.\n",
+             p, size);
+      break;
+    }
+
+    if (status & SLAB) {
+      Slab *slab = PTR(p + SLAB_HDR_OFS);
+      unsigned int used = 0;
+      for (unsigned int w = 0; w < SLAB_MAPW; w++) used += __builtin_popcountl(slab->map[w]);
+      used -= SLAB_MAPW*64 - slab->nobj;
+
+      if (dump) printf("      slab: object size %u, %u/%u used\n", slab->osize, used, slab->nobj);
+      if (used + slab->nfree != slab->nobj) {
+        errors++;
+        printf("    --> ERROR: slab %p: bitmap and free count differ\n", slab);
+      }
+      if (!slab_marked(slab)) {
+        errors++;
+        printf("    --> ERROR: slab %p: not marked in slab map\n", slab);
+      }
+    }
+
+    if (status == FREE) nfree++;
+    if (status & QUICK) nquick++;
+
+    int has_footer = 1;
+#ifdef ELIDE_FOOTER
+    if (((hdr & PREV_ALLOC) != 0) != prev_alloc) {
+      errors++;
+      printf("    --> ERROR: PREV_ALLOC bit of %p does not match previous block\n", p);
+    }
+    prev_alloc = status != FREE;
+    has_footer = status == FREE;
+#endif
+
+    if (has_footer) {
+      void *fp = p + size - TYPE_SIZE;
+      TYPE ftr = GET(fp);
+      size_t fsize = SIZE(ftr);
+      TYPE fstatus = STATUS(ftr);
+
+      if ((size != fsize) || (status != fstatus)) {
+        errors++;
+        printf("    --> ERROR: footer at %p with different properties: size: %lx, status: %lx\n",
+               fp, fsize, (unsigned long)fstatus);
+        if (dump) mm_panic("mm_check");
+      }
+    }
+
+    p = p + size;
+    if (size == 0) {
+      errors++;
+      printf("    WARNING: size 0 detected, aborting traversal.\n");
+      break;
+    }
+  }
+
+#ifdef ELIDE_FOOTER
+  if ((p == arena->heap_end) && (((GET(arena->heap_end) & PREV_ALLOC) != 0) != prev_alloc)) {
+    errors++;
+    printf("    --> ERROR: PREV_ALLOC bit of end sentinel does not match last block\n");
+  }
+#endif
+
+  //
+  // verify that the free lists contain exactly the free blocks of the heap
+  //
+  if (freelist_policy == fp_Tree) {
+    int height = 0;
+    long ntree = tree_check(UNLINK(arena->free_tree), NULL, NULL, 1, &height, &errors);
+
+    if (dump) printf("\n  free tree:              %ld nodes, height %d\n", ntree, height);
+    if (ntree != nfree) {
+      errors++;
+      printf("    --> ERROR: %ld free blocks in heap, but %ld blocks in tree\n", nfree, ntree);
+    }
+  }
+  else if (freelist_policy != fp_Implicit) {
+    void **heads = &arena->free_list;
+    int nheads = 1;
+    long nlist = 0;
+
+    if (freelist_policy == fp_Segregated) {
+      heads = arena->seg_list;
+      nheads = SEG_NUM;
+    } else if (freelist_policy == fp_TLSF) {
+      heads = &arena->tlsf_list[0][0];
+      nheads = TLSF_FL * TLSF_SL;
+    }
+
+    for (int c = 0; c < nheads; c++) {
+      if (freelist_policy == fp_TLSF) {
+        int fl = c / TLSF_SL, sl = c % TLSF_SL;
+        int marked = ((arena->tlsf_fl_bitmap >> fl) & 1) && ((arena->tlsf_sl_bitmap[fl] >> sl) & 1);
+        if (marked != (heads[c] != NULL)) {
+          errors++;
+          printf("    --> ERROR: TLSF bitmap mismatch for list [%d][%d]\n", fl, sl);
+        }
+      }
+
+      void *prev = NULL;
+      for (void *f = heads[c]; f != NULL; f = NEXT_LIST_GET(f)) {
+        if ((f < arena->heap_start) || (f >= arena->heap_end) || (GET_STATUS(f) != FREE) ||
+            (PREV_LIST_GET(f) != prev) || (fl_head(GET_SIZE(f)) != &heads[c])) {
+          errors++;
+          printf("    --> ERROR: invalid free list entry %p\n", f);
+          break;
+        }
+        if ((placement == pp_AddressOrdered) && (prev != NULL) && (f < prev)) {
+          errors++;
+          printf("    --> ERROR: free list entry %p not in address order\n", f);
+        }
+        prev = f;
+        nlist++;
+      }
+    }
+
+    if (nlist != nfree) {
+      errors++;
+      printf("    --> ERROR: %ld free blocks in heap, but %ld blocks on free lists\n", nfree, nlist);
+    }
+  }
+
+  //
+  // verify that the quick lists contain exactly the parked blocks of the heap
+  //
+  if (freelist_policy == fp_QuickFit) {
+    long nlist = 0;
+    size_t bytes = 0;
+
+    for (int c = 0; c < QUICK_NUM; c++) {
+      for (void *q = arena->quick_list[c]; q != NULL; q = NEXT_LIST_GET(q)) {
+        if ((q < arena->heap_start) || (q >= arena->heap_end) || (GET_STATUS(q) != (ALLOC | QUICK)) ||
+            (GET_SIZE(q) != (c + 1) * BS)) {
+          errors++;
+          printf("    --> ERROR: invalid quick list entry %p\n", q);
+          break;
+        }
+        nlist++;
+        bytes += GET_SIZE(q);
+      }
+    }
+
+    if (dump) printf("\n  quick lists:            %ld blocks, %lu bytes\n", nlist, bytes);
+    if ((nlist != nquick) || (bytes != arena->quick_bytes)) {
+      errors++;
+      printf("    --> ERROR: %ld quick blocks in heap, but %ld blocks (%lu bytes) on quick lists\n",
+             nquick, nlist, arena->quick_bytes);
+    }
+  }
+
+  if (dump) {
+    printf("\n");
+    if ((p == arena->heap_end) && (errors == 0)) printf("  Block structure coherent.\n");
+    printf("-------------------------------------------------------------------------------------------------\n");
+  }
+
+  return errors;
+}
+
+
+/// @brief check (and optionally dump) all arenas
+/// @param dump dump the heaps (1) or only report violations (0)
+/// @retval long number of violations
+static long check_arenas(int dump)
+{
+  assert(mm_initialized);
+
+  Arena *cur = arena;
+  long errors = 0;
+
+  for (int i = 0; i < narenas; i++) {
+    arena = &arenas[i];
+
+    LOCK(arena);
+#ifdef MM_THREADS
+    remote_drain();
+#endif
+    errors += arena_check(dump);
+    UNLOCK(arena);
+  }
+
+  arena = cur;
+
+  return errors;
+}
+
+
+void mm_check(void)
+{
+  check_arenas(1);
+}
+
+
+long mm_verify(void)
+{
+  return check_arenas(0);
+}
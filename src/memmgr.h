@@ -36,14 +36,38 @@
 
 #include <stddef.h>
 
+#include "dataseg.h"
+
+#define MM_MAXARENAS DS_MAXSEG          ///< maximal number of arenas (one data segment each)
+
 // !! Remove allocation policy !!
 
 /// @brief supported free list managing policies
 typedef enum {
   fp_Implicit,                    ///< Implicit list management
   fp_Explicit,                    ///< Explicit list management
+  fp_Segregated,                  ///< Segregated size-class lists
+  fp_Tree,                        ///< Balanced tree of free blocks
+  fp_TLSF,                        ///< Two-level segregated fit
+  fp_QuickFit,                    ///< Explicit list with quick lists (deferred coalescing)
 } FreelistPolicy;
 
+/// @brief assignment of threads to arenas
+typedef enum {
+  aa_RoundRobin,                  ///< threads are assigned to arenas round-robin on first use
+  aa_CPU,                         ///< threads use the arena of the CPU they are running on
+} ArenaAssignment;
+
+/// @brief placement policies of the implicit and explicit (and quick fit) free lists. The other
+///        free list policies have their own placement and ignore this setting.
+typedef enum {
+  pp_BestFit,                     ///< smallest block that fits (default)
+  pp_FirstFit,                    ///< first block that fits
+  pp_NextFit,                     ///< first block that fits after the previous allocation
+  pp_GoodFit,                     ///< first block within mm_setgoodfit() percent of the request
+  pp_AddressOrdered,              ///< first fit on free lists kept in address order
+} PlacementPolicy;
+
 /// @brief initialize heap. Must be called before any of the other functions can be used.
 void mm_init(FreelistPolicy ap);
 
@@ -67,15 +91,128 @@ void* mm_calloc(size_t nelem, size_t size);
 /// @retval NULL if memory allocation failed
 void* mm_realloc(void *ptr, size_t size);
 
+/// @brief allocate a block of memory of @a size bytes whose address is a multiple of @a alignment.
+///        The block can be resized with mm_realloc (which does not preserve the alignment) and
+///        released with mm_free.
+/// @param alignment alignment in bytes (power of 2)
+/// @param size requested size in bytes
+/// @retval void* pointer to first byte of memory on success
+/// @retval NULL if memory allocation failed or @a alignment is not a power of 2
+void* mm_aligned_alloc(size_t alignment, size_t size);
+
+/// @brief allocate a block of memory of @a size bytes aligned to @a alignment (posix_memalign)
+/// @param memptr location receiving the pointer to the allocated memory
+/// @param alignment alignment in bytes (power of 2, multiple of sizeof(void*))
+/// @param size requested size in bytes
+/// @retval 0 on success
+/// @retval EINVAL if @a alignment is invalid
+/// @retval ENOMEM if memory allocation failed
+int mm_posix_memalign(void **memptr, size_t alignment, size_t size);
+
+/// @brief allocate a block of memory of @a size bytes aligned to @a alignment (memalign)
+/// @param alignment alignment in bytes (power of 2)
+/// @param size requested size in bytes
+/// @retval void* pointer to first byte of memory on success
+/// @retval NULL if memory allocation failed
+void* mm_memalign(size_t alignment, size_t size);
+
 /// @brief free a previously allocated block of memory
-/// @param ptr pointer to allocated memory obtained by calling mm_malloc, mm_calloc, or mm_realloc
+/// @param ptr pointer to allocated memory obtained by calling mm_malloc, mm_calloc, mm_realloc, or
+///            one of the aligned allocation functions
 void mm_free(void *ptr);
 
+/// @brief allocate @a n blocks of memory of @a size bytes each with one call. Blocks are carved
+///        from one large free block where possible. Each block is freed individually with mm_free
+///        or together with mm_free_batch.
+/// @param size requested size in bytes
+/// @param n number of blocks
+/// @param out array of @a n pointers receiving the allocated blocks
+/// @retval size_t number of blocks allocated (out[0] ... out[retval-1]); less than @a n if memory
+///         allocation failed
+size_t mm_malloc_batch(size_t size, size_t n, void **out);
+
+/// @brief free @a n previously allocated blocks of memory with one call. Adjacent blocks are
+///        released (and coalesced) together.
+/// @param ptrs array of @a n pointers to allocated memory or NULL. The array is sorted by address.
+/// @param n number of pointers
+void mm_free_batch(void **ptrs, size_t n);
+
+/// @brief region of objects that are released together (opaque)
+typedef struct __region Region;
+
+/// @brief create a region. A region allocates objects from large chunks of memory obtained with
+///        mm_malloc and releases them all at once in mm_region_destroy. A region must not be used
+///        by more than one thread at a time.
+/// @param chunk_size size of the region's chunks in bytes (0: 64 KiB)
+/// @retval Region* new region on success
+/// @retval NULL if memory allocation failed
+Region* mm_region_create(size_t chunk_size);
+
+/// @brief allocate a block of memory of @a size bytes in region @a r. The block cannot be resized
+///        or freed individually.
+/// @param r region
+/// @param size requested size in bytes
+/// @retval void* pointer to first byte of memory on success
+/// @retval NULL if memory allocation failed
+void* mm_region_alloc(Region *r, size_t size);
+
+/// @brief release all blocks of region @a r and the region itself
+/// @param r region or NULL
+void mm_region_destroy(Region *r);
+
 /// @brief set log level
 /// @brief level log level (0: no logging, 1: info; 2: verbose)
 void mm_setloglevel(int level);
 
+/// @brief turn the slab sub-allocator for small requests on/off
+/// @param active (1: small requests are served from slabs, 0: all requests use the free list)
+void mm_setslab(int active);
+
+/// @brief turn the per-thread caches on/off. Only effective when built with -DMM_THREADS;
+///        objects that are already cached stay in their thread's cache.
+/// @param active (1: threads cache small objects, 0: every call locks the heap)
+void mm_settcache(int active);
+
+/// @brief set the size from which on requests are served from separately mapped regions that
+///        are returned to the system as soon as they are freed (default: 128 KiB)
+/// @param thld smallest mapped request in bytes (0: never map)
+void mm_setmmapthld(size_t thld);
+
+/// @brief set the size from which on the pages of free blocks are returned to the system
+///        (default: 64 KiB). Only the interior pages are released; the block stays in the heap.
+/// @param thld smallest decommitted free block in bytes (0: never decommit)
+void mm_setdecommit(size_t thld);
+
+/// @brief turn remote-free queues on/off. Only effective when built with -DMM_THREADS. When on,
+///        freeing an object of another thread's arena queues it for the owner without locking.
+/// @param active (1: queue remote frees, 0: lock the owner arena on every free)
+void mm_setremotefree(int active);
+
+/// @brief set the number of arenas and how threads are assigned to them. Each arena is a separate
+///        heap with its own data segment, free lists, and lock (see -DMM_THREADS). Arena 0 uses
+///        the data segment of ds_allocate(), the others allocate segments of the same size.
+///        Takes effect at the next mm_init().
+/// @param n number of arenas (1 ... MM_MAXARENAS)
+/// @param assign thread assignment policy
+void mm_setarenas(int n, ArenaAssignment assign);
+
+/// @brief set the placement policy of the implicit and explicit free lists. Takes effect at the
+///        next mm_init().
+/// @param pp placement policy
+void mm_setplacement(PlacementPolicy pp);
+
+/// @brief set the bound of the good fit placement policy: the search stops at the first block
+///        that exceeds the request by at most @a percent percent (default: 25). If there is no such
+///        block, the best fit is used.
+/// @param percent bound in percent of the request
+void mm_setgoodfit(unsigned int percent);
+
 /// @brief dump heap and perform some sanity checks
 void mm_check(void);
 
+/// @brief perform the sanity checks of mm_check() without dumping the heap. Violations are
+///        printed.
+/// @retval long number of violations (0: heap is coherent)
+long mm_verify(void);
+
 #endif // __MEMMGR_H__
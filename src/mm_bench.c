@@ -0,0 +1,1178 @@
+//--------------------------------------------------------------------------------------------------
+// System Programming                       Memory Lab                                   Spring 2024
+//
+/// @file
+/// @brief dynamic memory manager latency benchmark
+/// @section changelog Change Log
+/// 2024/05/06 created
+///
+/// @section license_section License
+/// Copyright (c) 2020-2023, Computer Systems and Platforms Laboratory, SNU
+/// All rights reserved.
+///
+/// Redistribution and use in source and binary forms, with or without modification, are permitted
+/// provided that the following conditions are met:
+///
+/// - Redistributions of source code must retain the above copyright notice, this list of condi-
+///   tions and the following disclaimer.
+/// - Redistributions in binary form must reproduce the above copyright notice, this list of condi-
+///   tions and the following disclaimer in the documentation and/or other materials provided with
+///   the distribution.
+///
+/// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+/// IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED  TO,  THE IMPLIED WARRANTIES OF MERCHANTABILITY
+/// AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+/// CONTRIBUTORS BE LIABLE FOR ANY DIRECT,  INDIRECT, INCIDENTAL,  SPECIAL,  EXEMPLARY,  OR CONSE-
+/// QUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,  PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+/// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)   HOWEVER CAUSED AND ON ANY THEORY OF
+/// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,  OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+/// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+/// DAMAGE.
+//--------------------------------------------------------------------------------------------------
+
+//
+// Latency benchmark
+// =================
+// mm_bench replays .dmas scripts against the memory manager and measures the latency of every
+// individual operation. Unlike mm_driver, it supports all free list policies of memmgr.h and
+// reports latency percentiles per operation type in addition to utilization and throughput.
+//
+// The script is parsed completely before the replay starts, only the calls to the memory manager
+// are timed. Script commands other than m/c/r/f, the batch actions M/F, and dataseg/heap are
+// ignored. 'M <id> <n> <size>' allocates blocks id ... id+n-1 with one mm_malloc_batch() call,
+// 'F <id> <n>' frees them with mm_free_batch(). --unbatch replays batch actions as individual
+// m/f actions for comparison; the throughput counts the blocks of a batch either way.
+//
+// --implementation selects the allocator under test: the memory manager (memmgr, default), the
+// region driver (region: all payloads come from one region that is destroyed at the end of the
+// script, frees are ignored), or the null driver (null: no memory is allocated at all).
+//
+// --placement selects the placement policy of the implicit and explicit lists (best, first,
+// next, good, or address; see mm_setplacement()), --goodfit the bound of the good fit policy in
+// percent of the request. Together with the utilization, the throughput and the latency
+// percentiles show what each policy trades for its speed on a given script.
+//
+// --check verifies the memory manager while a script is replayed (outside of the timed calls):
+// every payload is filled with a pattern derived from its id, which is verified before the block
+// is freed or reallocated (the preserved part after realloc), calloc'ed memory must be zero, a new
+// payload must not overlap any live payload, and mm_verify() checks the heap every CHECK_INTERVAL
+// actions and at the end. Errors are reported on stderr, and mm_bench exits with a non-zero
+// status if any check failed. The throughput is computed from the timed calls only.
+//
+// With --threads <n>, n threads replay the script concurrently on the shared heap, each with its
+// own set of block ids. Only the aggregate throughput is reported in this mode. It requires a
+// memory manager built with -DMM_THREADS. --arenas <n> spreads the threads over n arenas.
+//
+// With --handoff <n>, n producer/consumer thread pairs pass messages through a bounded ring. The
+// producer allocates messages with the request sizes of the script (m/c/r/M, in script order),
+// the consumer frees them. Running it with '--arenas 1 --no-tcache' (one global lock) and with
+// '--arenas 2n' (remote frees queued to the producer's arena, see --no-remote) shows the cost of
+// cross-thread deallocation.
+//
+// With --resize <size>, mm_bench measures the latency of growing a block with mm_realloc() for
+// block sizes up to <size> instead of replaying scripts. Compare the default (large blocks are
+// mapped, and their regions are remapped) with '--mmap-thld 0' (large blocks are copied).
+//
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <search.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "dataseg.h"
+#include "memmgr.h"
+#include "nulldriver.h"
+#include "regiondriver.h"
+
+
+/// @brief action types
+typedef enum {
+  a_Malloc,                       ///< m <id> <size>
+  a_Calloc,                       ///< c <id> <nmemb> <size>
+  a_Realloc,                      ///< r <id> <size>
+  a_Free,                         ///< f <id>
+  a_MallocBatch,                  ///< M <id> <n> <size>
+  a_FreeBatch,                    ///< F <id> <n>
+  a_NumActions,
+} ActionType;
+
+/// @brief a single script action
+typedef struct {
+  ActionType type;                ///< action type
+  long       id;                  ///< block id
+  size_t     nmemb;               ///< number of members (calloc) or blocks (batch actions)
+  size_t     size;                ///< size argument
+} Action;
+
+/// @brief a parsed script
+typedef struct {
+  Action     *action;             ///< array of actions
+  size_t     nactions;            ///< number of actions
+  size_t     nops;                ///< number of operations (batch actions count their blocks)
+  long       maxid;               ///< largest block id
+  size_t     dssize;              ///< data segment size
+  int        policy;              ///< free list policy (-1: not set)
+} Script;
+
+/// @brief policy names accepted on the command line and in the 'heap' script command
+static const struct {
+  const char     *name;
+  FreelistPolicy policy;
+} policies[] = {
+  { "implicit",   fp_Implicit   },
+  { "explicit",   fp_Explicit   },
+  { "segregated", fp_Segregated },
+  { "tree",       fp_Tree       },
+  { "tlsf",       fp_TLSF       },
+  { "quick",      fp_QuickFit   },
+};
+
+/// @brief placement policy names accepted on the command line
+static const char *placement_name[] = { "best", "first", "next", "good", "address" };
+
+/// @brief implementations accepted on the command line
+static const struct {
+  const char *name;
+  void*      (*malloc)(size_t);
+  void*      (*calloc)(size_t, size_t);
+  void*      (*realloc)(void*, size_t);
+  void       (*free)(void*);
+  void       (*release)(void);    ///< releases all payloads at the end of a script (optional)
+} implementations[] = {
+  { "memmgr", mm_malloc,     mm_calloc,     mm_realloc,     mm_free,     NULL           },
+  { "region", region_malloc, region_calloc, region_realloc, region_free, region_release },
+  { "null",   null_malloc,   null_calloc,   null_realloc,   null_free,   NULL           },
+};
+
+/// @brief data segment protection modes accepted on the command line
+static const char *mprotect_name[] = { "off", "full", "incremental", "guard" };
+
+/// @brief data segment page modes accepted on the command line
+static const char *pagemode_name[] = { "default", "4k", "thp", "hugetlb" };
+
+static const char *action_name[a_NumActions] = {
+  "malloc", "calloc", "realloc", "free", "mbatch", "fbatch"
+};
+
+/// @brief replay batch actions as individual actions (--unbatch)
+static int unbatch = 0;
+
+/// @brief verify payloads and the heap during the replay (--check)
+static int check = 0;
+
+#define CHECK_INTERVAL 4096           ///< actions between heap checks in --check mode
+#define CHECK_REPORT   10             ///< errors reported per script in --check mode
+
+/// @brief bytes occupied by a live payload (--check)
+typedef struct {
+  char       *start;              ///< first byte (NULL: no live payload)
+  char       *end;                ///< end of payload (at least start + 1)
+} Extent;
+
+/// @brief state of the checks of one script replay (--check)
+typedef struct {
+  Extent     *ext;                ///< extents of live payloads by id
+  void       *live;               ///< search tree of live extents (tsearch)
+  long       errors;              ///< number of failed checks
+} Checker;
+
+/// @brief placement policy (--placement) and good fit bound (--goodfit)
+static PlacementPolicy placement = pp_BestFit;
+static unsigned int goodfit = 25;
+
+
+/// @brief print error message and terminate
+static void fatal(const char *fmt, ...) __attribute__((format(printf, 1, 2), noreturn));
+static void fatal(const char *fmt, ...)
+{
+  va_list va;
+  va_start(va, fmt);
+  fprintf(stderr, "ERROR: ");
+  vfprintf(stderr, fmt, va);
+  fprintf(stderr, "\n");
+  va_end(va);
+  exit(EXIT_FAILURE);
+}
+
+/// @brief look up a free list policy by name
+/// @param name policy name
+/// @retval int policy
+/// @retval -1 if the name is unknown
+static int find_policy(const char *name)
+{
+  for (size_t i = 0; i < sizeof(policies)/sizeof(policies[0]); i++) {
+    if (strcmp(name, policies[i].name) == 0) return policies[i].policy;
+  }
+  return -1;
+}
+
+/// @brief return the name of a free list policy
+static const char* policy_name(int policy)
+{
+  for (size_t i = 0; i < sizeof(policies)/sizeof(policies[0]); i++) {
+    if (policies[i].policy == policy) return policies[i].name;
+  }
+  return "invalid";
+}
+
+/// @brief append an action to the script
+static void add_action(Script *s, Action a)
+{
+  if ((s->nactions & (s->nactions-1)) == 0) {
+    s->action = realloc(s->action, (s->nactions ? 2*s->nactions : 1)*sizeof(Action));
+    if (s->action == NULL) fatal("out of memory");
+  }
+  s->action[s->nactions++] = a;
+
+  size_t n = (a.type == a_MallocBatch) || (a.type == a_FreeBatch) ? a.nmemb : 1;
+  s->nops += n;
+  if (a.id + (long)n - 1 > s->maxid) s->maxid = a.id + n - 1;
+}
+
+/// @brief parse a .dmas script
+/// @param fn file name
+/// @param s script to fill in
+static void parse_script(const char *fn, Script *s)
+{
+  FILE *f = fopen(fn, "r");
+  if (f == NULL) fatal("cannot open '%s': %s", fn, strerror(errno));
+
+  memset(s, 0, sizeof(*s));
+  s->maxid = -1;
+  s->dssize = 0x4000000;
+  s->policy = -1;
+
+  char *line = NULL;
+  size_t llen = 0;
+  unsigned long lineno = 0;
+
+  while (getline(&line, &llen, f) > 0) {
+    char cmd[32], arg[64];
+    Action a = { 0 };
+    lineno++;
+
+    if (sscanf(line, "%31s", cmd) != 1 || cmd[0] == '#') continue;
+
+    if (strcmp(cmd, "dataseg") == 0) {
+      if (sscanf(line, "%*s %63s", arg) == 1) s->dssize = strtoul(arg, NULL, 0);
+    } else if (strcmp(cmd, "heap") == 0) {
+      if (sscanf(line, "%*s %63s", arg) == 1) s->policy = find_policy(arg);
+    } else if (strcmp(cmd, "m") == 0) {
+      a.type = a_Malloc;
+      if (sscanf(line, "%*s %ld %lu", &a.id, &a.size) != 2) fatal("%s:%lu: syntax error", fn, lineno);
+      add_action(s, a);
+    } else if (strcmp(cmd, "c") == 0) {
+      a.type = a_Calloc;
+      if (sscanf(line, "%*s %ld %lu %lu", &a.id, &a.nmemb, &a.size) != 3) fatal("%s:%lu: syntax error", fn, lineno);
+      add_action(s, a);
+    } else if (strcmp(cmd, "r") == 0) {
+      a.type = a_Realloc;
+      if (sscanf(line, "%*s %ld %lu", &a.id, &a.size) != 2) fatal("%s:%lu: syntax error", fn, lineno);
+      add_action(s, a);
+    } else if (strcmp(cmd, "f") == 0) {
+      a.type = a_Free;
+      if (sscanf(line, "%*s %ld", &a.id) != 1) fatal("%s:%lu: syntax error", fn, lineno);
+      add_action(s, a);
+    } else if ((strcmp(cmd, "M") == 0) || (strcmp(cmd, "F") == 0)) {
+      int alloc = cmd[0] == 'M';
+      int nargs = alloc ? sscanf(line, "%*s %ld %lu %lu", &a.id, &a.nmemb, &a.size)
+                         : sscanf(line, "%*s %ld %lu", &a.id, &a.nmemb);
+      if ((nargs != 2 + alloc) || (a.id < 0) || (a.nmemb == 0)) fatal("%s:%lu: syntax error", fn, lineno);
+
+      if (unbatch) {
+        Action b = { alloc ? a_Malloc : a_Free, 0, 0, a.size };
+        for (size_t k = 0; k < a.nmemb; k++) {
+          b.id = a.id + k;
+          add_action(s, b);
+        }
+      } else {
+        a.type = alloc ? a_MallocBatch : a_FreeBatch;
+        add_action(s, a);
+      }
+    }
+  }
+
+  free(line);
+  fclose(f);
+}
+
+/// @brief return the current time in nanoseconds
+static inline unsigned long now(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000000UL + ts.tv_nsec;
+}
+
+/// @brief compare two latencies (qsort callback)
+static int cmp_ulong(const void *a, const void *b)
+{
+  unsigned long x = *(const unsigned long*)a, y = *(const unsigned long*)b;
+  return (x > y) - (x < y);
+}
+
+/// @brief print latency percentiles of @a n samples. Sorts the samples.
+static void print_latency(const char *name, unsigned long *lat, size_t n)
+{
+  if (n == 0) return;
+
+  qsort(lat, n, sizeof(*lat), cmp_ulong);
+
+  unsigned long sum = 0;
+  for (size_t i = 0; i < n; i++) sum += lat[i];
+
+  printf("    %-8s %8lu  %8lu  %8lu  %8lu  %8lu  %8lu  %8lu\n", name, n, sum/n,
+         lat[n*50/100], lat[n*99/100], lat[n*999/1000], lat[n*9999/10000], lat[n-1]);
+}
+
+/// @brief report a failed check
+static void check_error(Checker *c, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+static void check_error(Checker *c, const char *fmt, ...)
+{
+  if (c->errors++ >= CHECK_REPORT) return;
+
+  va_list va;
+  va_start(va, fmt);
+  fprintf(stderr, "CHECK: ");
+  vfprintf(stderr, fmt, va);
+  fprintf(stderr, "\n");
+  va_end(va);
+}
+
+/// @brief order extents by address; overlapping extents compare equal (tsearch callback)
+static int cmp_extent(const void *a, const void *b)
+{
+  const Extent *x = a, *y = b;
+  return x->end <= y->start ? -1 : y->end <= x->start ? 1 : 0;
+}
+
+/// @brief return the pattern byte at offset @a k of the payload of block @a id
+static inline unsigned char pattern(long id, size_t k)
+{
+  return (unsigned char)(id*31 + k);
+}
+
+/// @brief fill bytes @a from ... @a to-1 of payload @a p of block @a id with its pattern
+static void check_fill(long id, char *p, size_t from, size_t to)
+{
+  for (size_t k = from; k < to; k++) p[k] = pattern(id, k);
+}
+
+/// @brief verify that the first @a size bytes of payload @a p of block @a id hold its pattern
+static void check_pattern(Checker *c, long id, char *p, size_t size, const char *when)
+{
+  for (size_t k = 0; k < size; k++) {
+    if ((unsigned char)p[k] != pattern(id, k)) {
+      check_error(c, "block %ld (%p, %lu bytes) corrupted at offset %lu %s", id, p, size, k, when);
+      return;
+    }
+  }
+}
+
+/// @brief add payload @a p of block @a id to the live payloads unless it overlaps one of them
+static void check_insert(Checker *c, long id, char *p, size_t size)
+{
+  Extent *e = &c->ext[id];
+  e->start = p;
+  e->end = p + (size > 0 ? size : 1);
+
+  Extent **other = tfind(e, &c->live, cmp_extent);
+  if (other != NULL) {
+    check_error(c, "block %ld (%p, %lu bytes) overlaps block %ld (%p, %lu bytes)", id, p, size,
+                *other - c->ext, (*other)->start, (*other)->end - (*other)->start);
+    e->start = NULL;
+    return;
+  }
+
+  if (tsearch(e, &c->live, cmp_extent) == NULL) fatal("out of memory");
+}
+
+/// @brief remove block @a id from the live payloads
+static void check_remove(Checker *c, long id)
+{
+  if (c->ext[id].start == NULL) return;
+
+  tdelete(&c->ext[id], &c->live, cmp_extent);
+  c->ext[id].start = NULL;
+}
+
+/// @brief check a new payload @a p of block @a id and fill it with its pattern
+/// @param zeroed the payload must be zero (calloc)
+static void check_alloc(Checker *c, long id, char *p, size_t size, int zeroed)
+{
+  check_remove(c, id);
+  if (p == NULL) return;
+
+  if (zeroed) {
+    for (size_t k = 0; k < size; k++) {
+      if (p[k] != 0) {
+        check_error(c, "calloc block %ld (%p, %lu bytes) not zeroed at offset %lu", id, p, size, k);
+        break;
+      }
+    }
+  }
+
+  check_insert(c, id, p, size);
+  check_fill(id, p, 0, size);
+}
+
+/// @brief verify payload @a p of block @a id before it is released (free, realloc)
+static void check_release(Checker *c, long id, char *p, size_t size)
+{
+  if (p == NULL) return;
+
+  check_pattern(c, id, p, size, "before release");
+  check_remove(c, id);
+}
+
+/// @brief extents are owned by the Checker (tdestroy callback)
+static void free_extent(void *e)
+{
+  (void)e;
+}
+
+/// @brief check the heap of the memory manager
+static void check_heap(Checker *c, size_t action)
+{
+  long errors = mm_verify();
+  if (errors > 0) check_error(c, "heap check after action %lu: %ld violations", action, errors);
+}
+
+/// @brief replay a script and print statistics
+/// @param fn file name of script
+/// @param policy free list policy (overrides the script if >= 0)
+/// @param dssize data segment size (overrides the script if > 0)
+/// @param impl index of implementation
+/// @retval long number of failed checks (--check)
+static long run_script(const char *fn, int policy, size_t dssize, int impl)
+{
+  Script s;
+  parse_script(fn, &s);
+
+  if (policy < 0) policy = s.policy >= 0 ? s.policy : fp_Implicit;
+  if (dssize == 0) dssize = s.dssize;
+
+  void   **ptr  = calloc(s.maxid+1, sizeof(void*));
+  size_t *psize = calloc(s.maxid+1, sizeof(size_t));
+  unsigned long *lat[a_NumActions];
+  size_t nlat[a_NumActions] = { 0 };
+  for (int t = 0; t < a_NumActions; t++) lat[t] = malloc((s.nactions+1)*sizeof(unsigned long));
+  unsigned long *all = malloc((s.nactions+1)*sizeof(unsigned long));
+  if ((ptr == NULL) || (psize == NULL) || (all == NULL)) fatal("out of memory");
+
+  Checker c = { NULL, NULL, 0 };
+  if (check && ((c.ext = calloc(s.maxid+1, sizeof(Extent))) == NULL)) fatal("out of memory");
+
+  unsigned long startup = now();
+  ds_allocate(dssize);
+  mm_init(policy);
+  startup = now() - startup;
+
+  size_t payload = 0, peak_payload = 0;
+  size_t nresize = 0, ninplace = 0, nmoved = 0;
+  unsigned long start = now();
+
+  for (size_t i = 0; i < s.nactions; i++) {
+    Action *a = &s.action[i];
+    unsigned long t0 = 0, t1 = 0;
+
+    // negative ids denote NULL pointers ('f -1' is free(NULL))
+    if (a->id < 0) {
+      if (a->type == a_Free) {
+        t0 = now(); implementations[impl].free(NULL); t1 = now();
+      }
+      lat[a->type][nlat[a->type]++] = t1 - t0;
+      all[i] = t1 - t0;
+      continue;
+    }
+
+    // verify payloads before they are released
+    if (check) {
+      if ((a->type == a_Free) || (a->type == a_Realloc)) {
+        check_release(&c, a->id, ptr[a->id], psize[a->id]);
+      } else if (a->type == a_FreeBatch) {
+        for (size_t k = 0; k < a->nmemb; k++) check_release(&c, a->id + k, ptr[a->id + k], psize[a->id + k]);
+      }
+    }
+
+    switch (a->type) {
+      case a_Malloc:
+        t0 = now(); ptr[a->id] = implementations[impl].malloc(a->size); t1 = now();
+        psize[a->id] = ptr[a->id] ? a->size : 0;
+        if (check) check_alloc(&c, a->id, ptr[a->id], psize[a->id], 0);
+        break;
+
+      case a_Calloc:
+        t0 = now(); ptr[a->id] = implementations[impl].calloc(a->nmemb, a->size); t1 = now();
+        psize[a->id] = ptr[a->id] ? a->nmemb*a->size : 0;
+        if (check) check_alloc(&c, a->id, ptr[a->id], psize[a->id], 1);
+        break;
+
+      case a_Realloc: {
+        void *old = ptr[a->id];
+        t0 = now(); void *p = implementations[impl].realloc(old, a->size); t1 = now();
+
+        // the preserved part must be intact; a failed realloc leaves the old payload live
+        if (check) {
+          if (p != NULL) {
+            size_t kept = psize[a->id] < a->size ? psize[a->id] : a->size;
+            check_pattern(&c, a->id, p, kept, "after realloc");
+            check_insert(&c, a->id, p, a->size);
+            check_fill(a->id, p, 0, a->size);
+          } else if ((old != NULL) && (a->size > 0)) {
+            check_insert(&c, a->id, old, psize[a->id]);
+          }
+        }
+
+        // resized in place, or moved within the old block's neighborhood (overlapping payloads)
+        if ((old != NULL) && (p != NULL)) {
+          nresize++;
+          if (p == old) ninplace++;
+          else if ((p < old + psize[a->id]) && (old < p + a->size)) nmoved++;
+        }
+
+        if ((p != NULL) || (a->size == 0)) {
+          payload -= psize[a->id];
+          ptr[a->id] = p;
+          psize[a->id] = p ? a->size : 0;
+        }
+        break;
+      }
+
+      case a_Free:
+        t0 = now(); implementations[impl].free(ptr[a->id]); t1 = now();
+        ptr[a->id] = NULL;
+        payload -= psize[a->id];
+        psize[a->id] = 0;
+        break;
+
+      case a_MallocBatch: {
+        t0 = now(); size_t n = mm_malloc_batch(a->size, a->nmemb, &ptr[a->id]); t1 = now();
+        for (size_t k = 0; k < a->nmemb; k++) {
+          if (k >= n) ptr[a->id + k] = NULL;
+          psize[a->id + k] = k < n ? a->size : 0;
+          if (check) check_alloc(&c, a->id + k, ptr[a->id + k], psize[a->id + k], 0);
+        }
+        payload += n*a->size;
+        break;
+      }
+
+      case a_FreeBatch:
+        // mm_free_batch() sorts the pointers; the ids are released as a whole
+        t0 = now(); mm_free_batch(&ptr[a->id], a->nmemb); t1 = now();
+        for (size_t k = 0; k < a->nmemb; k++) {
+          ptr[a->id + k] = NULL;
+          payload -= psize[a->id + k];
+          psize[a->id + k] = 0;
+        }
+        break;
+
+      default:
+        break;
+    }
+
+    if ((a->type == a_Malloc) || (a->type == a_Calloc) || (a->type == a_Realloc)) payload += psize[a->id];
+    if (payload > peak_payload) peak_payload = payload;
+
+    lat[a->type][nlat[a->type]++] = t1 - t0;
+    all[i] = t1 - t0;
+
+    if (check && ((i+1) % CHECK_INTERVAL == 0)) check_heap(&c, i);
+  }
+
+  unsigned long total = now() - start;
+
+  // with --check, only the timed calls count
+  if (check) {
+    total = 0;
+    for (size_t i = 0; i < s.nactions; i++) total += all[i];
+  }
+
+  // payloads that are still live must be intact
+  if (check) {
+    for (long id = 0; id <= s.maxid; id++) {
+      if (c.ext[id].start != NULL) check_pattern(&c, id, ptr[id], psize[id], "at end of script");
+    }
+    check_heap(&c, s.nactions);
+  }
+
+  void *heap_start, *heap_brk;
+  ds_heap_stat(&heap_start, &heap_brk, NULL);
+  size_t heap_size = heap_brk - heap_start;
+
+  // implementations without individual frees release all payloads at the end (timed)
+  if (implementations[impl].release != NULL) {
+    unsigned long t0 = now();
+    implementations[impl].release();
+    total += now() - t0;
+  }
+
+  ssize_t nmap;
+  size_t peak_mapped;
+  ds_region_stat(&nmap, NULL, &peak_mapped);
+
+  struct rusage ru;
+  getrusage(RUSAGE_SELF, &ru);
+
+  printf("------------------------------------------------------------\n"
+         "Benchmark:\n"
+         "  script file:           %s\n"
+         "  implementation:        %s\n"
+         "  freelist policy:       %s\n"
+         "  placement policy:      %s (good fit bound: %u%%)\n"
+         "  data segment size:     0x%lx (%lu)\n"
+         "  page mode:             %s\n"
+         "\n"
+         "  Utilization:\n"
+         "    peak payload:        %lu bytes\n"
+         "    heap size:           %lu bytes\n"
+         "    peak mapped:         %lu bytes\n"
+         "    utilization:         %.1f%%\n"
+         "    #sbrk():             %ld times\n"
+         "    #trim:               %ld times\n"
+         "    #mapped regions:     %ld\n"
+         "    decommitted pages:   %ld\n"
+         "    prefaulted pages:    %ld\n"
+         "    peak RSS (process):  %ld KiB\n"
+         "\n"
+         "  Performance:\n"
+         "    startup time:        %.6f sec\n"
+         "    total time:          %.6f sec\n"
+         "    throughput:          %.2f kops/sec\n"
+         "    realloc in place:    %lu of %lu (%.1f%%), %lu more moved in place\n"
+         "\n"
+         "  Latency [ns]:\n"
+         "    %-8s %8s  %8s  %8s  %8s  %8s  %8s  %8s\n",
+         fn, implementations[impl].name, policy_name(policy),
+         (policy == fp_Implicit) || (policy == fp_Explicit) || (policy == fp_QuickFit) ?
+           placement_name[placement] : "n/a", goodfit,
+         dssize, dssize, pagemode_name[ds_getpagemode()],
+         peak_payload, heap_size, peak_mapped,
+         heap_size + peak_mapped ? 100.0*peak_payload/(heap_size + peak_mapped) : 0.0,
+         ds_getnsbrk(), ds_getntrim(), nmap, ds_getndecommit(), ds_getnprefault(), ru.ru_maxrss,
+         startup/1e9, total/1e9, total ? s.nops/(total/1e6) : 0.0,
+         ninplace, nresize, nresize ? 100.0*ninplace/nresize : 0.0, nmoved,
+         "op", "count", "avg", "p50", "p99", "p99.9", "p99.99", "max");
+
+  for (int t = 0; t < a_NumActions; t++) print_latency(action_name[t], lat[t], nlat[t]);
+  print_latency("all", all, s.nactions);
+  if (check) {
+    printf("\n"
+           "  check:                 %s (%ld errors)\n", c.errors ? "FAILED" : "passed", c.errors);
+  }
+  printf("------------------------------------------------------------\n");
+
+  for (int t = 0; t < a_NumActions; t++) free(lat[t]);
+  free(all);
+  free(ptr);
+  free(psize);
+  free(s.action);
+  tdestroy(c.live, free_extent);
+  free(c.ext);
+  ds_release();
+
+  return c.errors;
+}
+
+/// @brief replay thread
+typedef struct {
+  pthread_t  thread;              ///< thread handle
+  Script     *s;                  ///< script to replay
+  int        error;               ///< set if an allocation failed
+} Worker;
+
+/// @brief replay the script of worker @a arg without timing individual operations
+static void* replay(void *arg)
+{
+  Worker *w = arg;
+  Script *s = w->s;
+
+  void **ptr = calloc(s->maxid+1, sizeof(void*));
+  if (ptr == NULL) fatal("out of memory");
+
+  for (size_t i = 0; i < s->nactions; i++) {
+    Action *a = &s->action[i];
+    void *p = a->id >= 0 ? ptr[a->id] : NULL;
+
+    switch (a->type) {
+      case a_Malloc:  p = mm_malloc(a->size); w->error |= (p == NULL) && (a->size > 0); break;
+      case a_Calloc:  p = mm_calloc(a->nmemb, a->size); w->error |= (p == NULL) && (a->nmemb*a->size > 0); break;
+      case a_Realloc: p = mm_realloc(p, a->size); w->error |= (p == NULL) && (a->size > 0); break;
+      case a_Free:    mm_free(p); p = NULL; break;
+
+      case a_MallocBatch:
+        w->error |= mm_malloc_batch(a->size, a->nmemb, &ptr[a->id]) < a->nmemb;
+        continue;
+
+      case a_FreeBatch:
+        mm_free_batch(&ptr[a->id], a->nmemb);
+        memset(&ptr[a->id], 0, a->nmemb*sizeof(void*));
+        continue;
+
+      default:        break;
+    }
+
+    if (a->id >= 0) ptr[a->id] = p;
+  }
+
+  free(ptr);
+  return NULL;
+}
+
+/// @brief replay a script concurrently in @a nthreads threads and print the throughput
+/// @param fn file name of script
+/// @param policy free list policy (overrides the script if >= 0)
+/// @param dssize data segment size (overrides the script if > 0)
+/// @param nthreads number of threads
+/// @param tcache use per-thread caches
+/// @param narenas number of arenas
+/// @param assign assignment of threads to arenas
+static void run_threads(const char *fn, int policy, size_t dssize, int nthreads, int tcache,
+                        int narenas, ArenaAssignment assign)
+{
+  Script s;
+  parse_script(fn, &s);
+
+  if (policy < 0) policy = s.policy >= 0 ? s.policy : fp_Implicit;
+  if (dssize == 0) dssize = s.dssize;
+
+  Worker *w = calloc(nthreads, sizeof(Worker));
+  if (w == NULL) fatal("out of memory");
+
+  ds_allocate(dssize);
+  mm_setarenas(narenas, assign);
+  mm_init(policy);
+  mm_settcache(tcache);
+
+  unsigned long start = now();
+  for (int t = 0; t < nthreads; t++) {
+    w[t].s = &s;
+    if (pthread_create(&w[t].thread, NULL, replay, &w[t]) != 0) fatal("cannot create thread");
+  }
+
+  int errors = 0;
+  for (int t = 0; t < nthreads; t++) {
+    pthread_join(w[t].thread, NULL);
+    errors += w[t].error;
+  }
+  unsigned long total = now() - start;
+
+  // sum up the heaps of all arenas
+  size_t heap_size = 0;
+  for (int seg = 0; seg < DS_MAXSEG; seg++) {
+    void *heap_start, *heap_brk;
+    ds_heap_stat_seg(seg, &heap_start, &heap_brk, NULL);
+    heap_size += heap_brk - heap_start;
+  }
+
+  printf("------------------------------------------------------------\n"
+         "Benchmark:\n"
+         "  script file:           %s\n"
+         "  freelist policy:       %s\n"
+         "  data segment size:     0x%lx (%lu)\n"
+         "  threads:               %d\n"
+         "  thread caches:         %s\n"
+         "  arenas:                %d (%s)\n"
+         "\n"
+         "  Utilization:\n"
+         "    heap size:           %lu bytes\n"
+         "    #sbrk():             %ld times\n"
+         "    #trim:               %ld times\n"
+         "    failed requests:     %d threads\n"
+         "\n"
+         "  Performance:\n"
+         "    total time:          %.6f sec\n"
+         "    throughput:          %.2f kops/sec\n"
+         "------------------------------------------------------------\n",
+         fn, policy_name(policy), dssize, dssize, nthreads, tcache ? "on" : "off",
+         narenas, assign == aa_CPU ? "by CPU" : "round-robin",
+         heap_size, ds_getnsbrk(), ds_getntrim(), errors,
+         total/1e9, total ? nthreads*s.nops/(total/1e6) : 0.0);
+
+  mm_settcache(1);
+  mm_setarenas(1, aa_RoundRobin);
+  free(w);
+  free(s.action);
+  ds_release();
+}
+
+#define RING_SIZE 1024             ///< capacity of a handoff ring. Must be a power of 2
+
+/// @brief producer/consumer pair of the handoff benchmark
+typedef struct {
+  pthread_t     producer;         ///< producer thread handle
+  pthread_t     consumer;         ///< consumer thread handle
+  size_t        *size;            ///< message sizes
+  size_t        nsize;            ///< number of messages
+  void          *ring[RING_SIZE]; ///< messages in transit
+  unsigned long head;             ///< next slot read by the consumer
+  unsigned long tail;             ///< next slot written by the producer
+  int           error;            ///< set if an allocation failed
+} Pair;
+
+/// @brief allocate the messages of pair @a arg and pass them to the consumer. A NULL message
+///        ends the stream.
+static void* produce(void *arg)
+{
+  Pair *p = arg;
+
+  for (size_t i = 0; i <= p->nsize; i++) {
+    void *msg = NULL;
+    if (i < p->nsize) {
+      msg = mm_malloc(p->size[i]);
+      if (msg == NULL) { p->error = 1; continue; }
+      *(char*)msg = 1;
+    }
+
+    while (p->tail - __atomic_load_n(&p->head, __ATOMIC_ACQUIRE) == RING_SIZE) sched_yield();
+    p->ring[p->tail % RING_SIZE] = msg;
+    __atomic_store_n(&p->tail, p->tail + 1, __ATOMIC_RELEASE);
+  }
+
+  return NULL;
+}
+
+/// @brief free the messages of pair @a arg until the end of the stream
+static void* consume(void *arg)
+{
+  Pair *p = arg;
+
+  for (;;) {
+    while (__atomic_load_n(&p->tail, __ATOMIC_ACQUIRE) == p->head) sched_yield();
+    void *msg = p->ring[p->head % RING_SIZE];
+    __atomic_store_n(&p->head, p->head + 1, __ATOMIC_RELEASE);
+
+    if (msg == NULL) break;
+    mm_free(msg);
+  }
+
+  return NULL;
+}
+
+/// @brief run the producer/consumer handoff benchmark with the request sizes of a script
+/// @param fn file name of script
+/// @param policy free list policy (overrides the script if >= 0)
+/// @param dssize data segment size (overrides the script if > 0)
+/// @param npairs number of producer/consumer pairs
+/// @param tcache use per-thread caches
+/// @param narenas number of arenas
+/// @param assign assignment of threads to arenas
+/// @param remote queue remote frees
+static void run_handoff(const char *fn, int policy, size_t dssize, int npairs, int tcache,
+                        int narenas, ArenaAssignment assign, int remote)
+{
+  Script s;
+  parse_script(fn, &s);
+
+  if (policy < 0) policy = s.policy >= 0 ? s.policy : fp_Implicit;
+  if (dssize == 0) dssize = s.dssize;
+
+  // message sizes: the non-empty allocation requests of the script
+  size_t *size = malloc((s.nops+1)*sizeof(size_t)), nsize = 0;
+  if (size == NULL) fatal("out of memory");
+  for (size_t i = 0; i < s.nactions; i++) {
+    Action *a = &s.action[i];
+    size_t sz = a->type == a_Calloc ? a->nmemb*a->size : a->size;
+    size_t n = a->type == a_MallocBatch ? a->nmemb : 1;
+    if ((a->type != a_Free) && (a->type != a_FreeBatch) && (sz > 0)) {
+      while (n-- > 0) size[nsize++] = sz;
+    }
+  }
+
+  Pair *p = calloc(npairs, sizeof(Pair));
+  if (p == NULL) fatal("out of memory");
+
+  ds_allocate(dssize);
+  mm_setarenas(narenas, assign);
+  mm_init(policy);
+  mm_settcache(tcache);
+  mm_setremotefree(remote);
+
+  unsigned long start = now();
+  for (int t = 0; t < npairs; t++) {
+    p[t].size = size;
+    p[t].nsize = nsize;
+    if ((pthread_create(&p[t].producer, NULL, produce, &p[t]) != 0) ||
+        (pthread_create(&p[t].consumer, NULL, consume, &p[t]) != 0)) fatal("cannot create thread");
+  }
+
+  int errors = 0;
+  for (int t = 0; t < npairs; t++) {
+    pthread_join(p[t].producer, NULL);
+    pthread_join(p[t].consumer, NULL);
+    errors += p[t].error;
+  }
+  unsigned long total = now() - start;
+
+  printf("------------------------------------------------------------\n"
+         "Handoff benchmark:\n"
+         "  script file:           %s\n"
+         "  freelist policy:       %s\n"
+         "  data segment size:     0x%lx (%lu)\n"
+         "  producer/consumer:     %d pairs\n"
+         "  thread caches:         %s\n"
+         "  arenas:                %d (%s)\n"
+         "  remote frees:          %s\n"
+         "\n"
+         "  Performance:\n"
+         "    messages:            %lu\n"
+         "    failed requests:     %d threads\n"
+         "    total time:          %.6f sec\n"
+         "    throughput:          %.2f kmsgs/sec\n"
+         "------------------------------------------------------------\n",
+         fn, policy_name(policy), dssize, dssize, npairs, tcache ? "on" : "off",
+         narenas, assign == aa_CPU ? "by CPU" : "round-robin", remote ? "queued" : "locked",
+         npairs*nsize, errors, total/1e9, total ? npairs*nsize/(total/1e6) : 0.0);
+
+  mm_setremotefree(1);
+  mm_settcache(1);
+  mm_setarenas(1, aa_RoundRobin);
+  free(p);
+  free(size);
+  free(s.action);
+  ds_release();
+}
+
+#define RESIZE_MIN  (1UL<<16)      ///< smallest block size of the realloc sweep
+#define RESIZE_REPS 15              ///< measurements per block size
+
+/// @brief measure the latency of mm_realloc() against the block size. Block sizes double from
+///        RESIZE_MIN up to @a max. Each measurement starts with a fresh heap, allocates and fills
+///        the block, and grows it by one eighth. A small allocation behind the block keeps a heap
+///        block from growing in place. Prints the median of RESIZE_REPS measurements per size.
+/// @param policy free list policy (fp_Implicit if < 0)
+/// @param dssize data segment size (derived from @a max if 0)
+/// @param max largest block size
+static void run_resize(int policy, size_t dssize, size_t max)
+{
+  if (policy < 0) policy = fp_Implicit;
+  if (dssize == 0) dssize = 4*max + (1UL<<24);
+
+  printf("------------------------------------------------------------\n"
+         "Realloc sweep:\n"
+         "  freelist policy:       %s\n"
+         "  data segment size:     0x%lx (%lu)\n"
+         "\n"
+         "  %12s  %12s  %12s  %6s\n",
+         policy_name(policy), dssize, dssize, "size", "realloc [ns]", "[ns/MiB]", "moved");
+
+  for (size_t size = RESIZE_MIN; size <= max; size *= 2) {
+    unsigned long lat[RESIZE_REPS];
+    int moved = 0;
+
+    for (int r = 0; r < RESIZE_REPS; r++) {
+      ds_allocate(dssize);
+      mm_init(policy);
+
+      char *p = mm_malloc(size);
+      void *q = mm_malloc(64);
+      if ((p == NULL) || (q == NULL)) fatal("cannot allocate %lu bytes", size);
+      memset(p, r+1, size);
+
+      unsigned long t0 = now();
+      char *np = mm_realloc(p, size + size/8);
+      lat[r] = now() - t0;
+
+      if (np == NULL) fatal("cannot reallocate %lu bytes", size + size/8);
+      if ((np[0] != r+1) || (np[size-1] != r+1)) fatal("realloc lost the contents of the block");
+      moved += (np != p);
+
+      mm_free(np);
+      mm_free(q);
+      ds_release();
+    }
+
+    qsort(lat, RESIZE_REPS, sizeof(*lat), cmp_ulong);
+    unsigned long median = lat[RESIZE_REPS/2];
+
+    printf("  %12lu  %12lu  %12.0f  %3d/%-2d\n", size, median, median / (size/1048576.0),
+           moved, RESIZE_REPS);
+  }
+  printf("------------------------------------------------------------\n");
+}
+
+/// @brief print usage and terminate
+static void syntax(const char *argv0)
+{
+  printf("Syntax: %s [--implementation <impl>] [--policy <policy>] [--dssize <size>]\n"
+         "                [--placement <placement>] [--goodfit <percent>]\n"
+         "                [--threads <n>] [--no-tcache]\n"
+         "                [--arenas <n>] [--arena-cpu] [--handoff <n>] [--no-remote]\n"
+         "                [--mmap-thld <size>] [--mprotect <mode>] [--populate]\n"
+         "                [--decommit <size>] [--pages <mode>] [--prefault <size>]\n"
+         "                [--resize <size>] [--unbatch] [--check] [--help] <script(s)>\n"
+         "\n"
+         "  --implementation <impl>    select implementation from one of\n", argv0);
+  for (size_t i = 0; i < sizeof(implementations)/sizeof(implementations[0]); i++) {
+    printf("                               %s\n", implementations[i].name);
+  }
+  printf("  --policy <policy>          set freelist policy to one of\n");
+  for (size_t i = 0; i < sizeof(policies)/sizeof(policies[0]); i++) {
+    printf("                               %s\n", policies[i].name);
+  }
+  printf("  --placement <placement>    set placement policy of the implicit and explicit lists\n"
+         "                             to one of\n");
+  for (size_t i = 0; i < sizeof(placement_name)/sizeof(placement_name[0]); i++) {
+    printf("                               %s\n", placement_name[i]);
+  }
+  printf("  --goodfit <percent>        stop good fit search at blocks within <percent> of the\n"
+         "                             request (default: 25)\n"
+         "  --dssize <size>            set size of datasegment to <size>\n"
+         "  --threads <n>              replay each script concurrently in <n> threads\n"
+         "  --no-tcache                disable per-thread caches (all calls take the heap lock)\n"
+         "  --arenas <n>               distribute threads over <n> arenas (round-robin)\n"
+         "  --arena-cpu                assign threads to arenas by CPU\n"
+         "  --handoff <n>              run <n> producer/consumer pairs with the script's sizes\n"
+         "  --no-remote                free objects of other arenas under their lock\n"
+         "  --mmap-thld <size>         map requests of at least <size> bytes separately (0: off)\n"
+         "  --mprotect <mode>          protection of the data segment past brk: off, full,\n"
+         "                             incremental (default), or guard\n"
+         "  --populate                 prefault the data segment instead of faulting on demand\n"
+         "  --decommit <size>          release pages of free blocks of at least <size> bytes (0: off)\n"
+         "  --pages <mode>             page size of the data segment: default, 4k, thp (2 MiB\n"
+         "                             transparent huge pages), or hugetlb (MAP_HUGETLB)\n"
+         "  --prefault <size>          fault in pages up to <size> bytes past brk in a helper\n"
+         "                             thread (0: off)\n"
+         "  --resize <size>            measure realloc latency for block sizes up to <size>\n"
+         "                             instead of replaying scripts\n"
+         "  --unbatch                  replay batch actions (M/F) as individual m/f actions\n"
+         "  --check                    verify payloads and the heap during the replay; exit with\n"
+         "                             a non-zero status on errors\n"
+         "  --help                     this screen\n"
+         "\n"
+         "  <script(s)>                one or more .dmas scripts\n"
+         "\n"
+         "Note: settings given on the command line override settings in the script files.\n");
+  exit(EXIT_SUCCESS);
+}
+
+int main(int argc, char *argv[])
+{
+  int policy = -1, impl = 0;
+  size_t dssize = 0;
+  size_t resize = 0;
+  int nthreads = 1, tcache = 1, narenas = 1, npairs = 0, remote = 1;
+  ArenaAssignment assign = aa_RoundRobin;
+  char **script = calloc(argc, sizeof(char*));
+  int nscripts = 0;
+
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--help") == 0) {
+      syntax(argv[0]);
+    } else if (strcmp(argv[i], "--implementation") == 0) {
+      if (++i >= argc) fatal("missing argument after %s", argv[i-1]);
+      impl = -1;
+      for (size_t m = 0; m < sizeof(implementations)/sizeof(implementations[0]); m++) {
+        if (strcmp(argv[i], implementations[m].name) == 0) impl = m;
+      }
+      if (impl < 0) fatal("invalid implementation '%s'", argv[i]);
+    } else if (strcmp(argv[i], "--policy") == 0) {
+      if (++i >= argc) fatal("missing argument after %s", argv[i-1]);
+      if ((policy = find_policy(argv[i])) < 0) fatal("invalid policy '%s'", argv[i]);
+    } else if (strcmp(argv[i], "--placement") == 0) {
+      if (++i >= argc) fatal("missing argument after %s", argv[i-1]);
+      int pp = -1;
+      for (int m = pp_BestFit; m <= pp_AddressOrdered; m++) {
+        if (strcmp(argv[i], placement_name[m]) == 0) pp = m;
+      }
+      if (pp < 0) fatal("invalid placement policy '%s'", argv[i]);
+      mm_setplacement(placement = pp);
+    } else if (strcmp(argv[i], "--goodfit") == 0) {
+      if (++i >= argc) fatal("missing argument after %s", argv[i-1]);
+      mm_setgoodfit(goodfit = strtoul(argv[i], NULL, 0));
+    } else if (strcmp(argv[i], "--dssize") == 0) {
+      if (++i >= argc) fatal("missing argument after %s", argv[i-1]);
+      dssize = strtoul(argv[i], NULL, 0);
+    } else if (strcmp(argv[i], "--threads") == 0) {
+      if (++i >= argc) fatal("missing argument after %s", argv[i-1]);
+      if ((nthreads = atoi(argv[i])) < 1) fatal("invalid number of threads '%s'", argv[i]);
+    } else if (strcmp(argv[i], "--no-tcache") == 0) {
+      tcache = 0;
+    } else if (strcmp(argv[i], "--arenas") == 0) {
+      if (++i >= argc) fatal("missing argument after %s", argv[i-1]);
+      if (((narenas = atoi(argv[i])) < 1) || (narenas > MM_MAXARENAS)) fatal("invalid number of arenas '%s'", argv[i]);
+    } else if (strcmp(argv[i], "--arena-cpu") == 0) {
+      assign = aa_CPU;
+    } else if (strcmp(argv[i], "--handoff") == 0) {
+      if (++i >= argc) fatal("missing argument after %s", argv[i-1]);
+      if ((npairs = atoi(argv[i])) < 1) fatal("invalid number of pairs '%s'", argv[i]);
+    } else if (strcmp(argv[i], "--no-remote") == 0) {
+      remote = 0;
+    } else if (strcmp(argv[i], "--mmap-thld") == 0) {
+      if (++i >= argc) fatal("missing argument after %s", argv[i-1]);
+      mm_setmmapthld(strtoul(argv[i], NULL, 0));
+    } else if (strcmp(argv[i], "--mprotect") == 0) {
+      if (++i >= argc) fatal("missing argument after %s", argv[i-1]);
+      int mode = -1;
+      for (int m = pm_Off; m <= pm_Guard; m++) {
+        if (strcmp(argv[i], mprotect_name[m]) == 0) mode = m;
+      }
+      if (mode < 0) fatal("invalid protection mode '%s'", argv[i]);
+      ds_setmprotect(mode);
+    } else if (strcmp(argv[i], "--populate") == 0) {
+      ds_setpopulate(1);
+    } else if (strcmp(argv[i], "--decommit") == 0) {
+      if (++i >= argc) fatal("missing argument after %s", argv[i-1]);
+      mm_setdecommit(strtoul(argv[i], NULL, 0));
+    } else if (strcmp(argv[i], "--pages") == 0) {
+      if (++i >= argc) fatal("missing argument after %s", argv[i-1]);
+      int mode = -1;
+      for (int m = pg_Default; m <= pg_HugeTLB; m++) {
+        if (strcmp(argv[i], pagemode_name[m]) == 0) mode = m;
+      }
+      if (mode < 0) fatal("invalid page mode '%s'", argv[i]);
+      ds_setpagemode(mode);
+    } else if (strcmp(argv[i], "--resize") == 0) {
+      if (++i >= argc) fatal("missing argument after %s", argv[i-1]);
+      if ((resize = strtoul(argv[i], NULL, 0)) < RESIZE_MIN) fatal("invalid size '%s'", argv[i]);
+    } else if (strcmp(argv[i], "--unbatch") == 0) {
+      unbatch = 1;
+    } else if (strcmp(argv[i], "--check") == 0) {
+      check = 1;
+    } else if (strcmp(argv[i], "--prefault") == 0) {
+      if (++i >= argc) fatal("missing argument after %s", argv[i-1]);
+      ds_setprefault(strtoul(argv[i], NULL, 0));
+    } else {
+      script[nscripts++] = argv[i];
+    }
+  }
+
+  if (resize > 0) run_resize(policy, dssize, resize);
+  else if (nscripts == 0) syntax(argv[0]);
+
+  // batch actions are specific to the memory manager
+  if (impl > 0) {
+    if ((nthreads > 1) || (npairs > 0)) fatal("--threads and --handoff require the memmgr implementation");
+    unbatch = 1;
+  }
+
+  if (check) {
+    if ((nthreads > 1) || (npairs > 0)) fatal("--check is not supported with --threads and --handoff");
+    if (strcmp(implementations[impl].name, "null") == 0) fatal("--check requires an implementation that returns memory");
+  }
+
+#ifndef MM_THREADS
+  if (nthreads > 1) fatal("--threads requires a memory manager built with -DMM_THREADS");
+  if (npairs > 0) fatal("--handoff requires a memory manager built with -DMM_THREADS");
+#endif
+
+  long errors = 0;
+  for (int i = 0; i < nscripts; i++) {
+    if (npairs > 0) run_handoff(script[i], policy, dssize, npairs, tcache, narenas, assign, remote);
+    else if (nthreads > 1) run_threads(script[i], policy, dssize, nthreads, tcache, narenas, assign);
+    else errors += run_script(script[i], policy, dssize, impl);
+  }
+  free(script);
+  ds_setprefault(0);
+
+  return errors > 0 ? EXIT_FAILURE : EXIT_SUCCESS;
+}
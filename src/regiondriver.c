@@ -0,0 +1,101 @@
+//--------------------------------------------------------------------------------------------------
+// System Programming                       Memory Lab                                   Spring 2024
+//
+/// @file
+/// @brief region driver (malloc interfaces on top of a memory manager region)
+/// @section changelog Change Log
+/// 2024/05/27 created
+///
+/// @section license_section License
+/// Copyright (c) 2020-2023, Computer Systems and Platforms Laboratory, SNU
+/// All rights reserved.
+///
+/// Redistribution and use in source and binary forms, with or without modification, are permitted
+/// provided that the following conditions are met:
+///
+/// - Redistributions of source code must retain the above copyright notice, this list of condi-
+///   tions and the following disclaimer.
+/// - Redistributions in binary form must reproduce the above copyright notice, this list of condi-
+///   tions and the following disclaimer in the documentation and/or other materials provided with
+///   the distribution.
+///
+/// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+/// IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED  TO,  THE IMPLIED WARRANTIES OF MERCHANTABILITY
+/// AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+/// CONTRIBUTORS BE LIABLE FOR ANY DIRECT,  INDIRECT, INCIDENTAL,  SPECIAL,  EXEMPLARY,  OR CONSE-
+/// QUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,  PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+/// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)   HOWEVER CAUSED AND ON ANY THEORY OF
+/// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,  OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+/// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+/// DAMAGE.
+//--------------------------------------------------------------------------------------------------
+
+//
+// The region driver serves the malloc interface from a single region of the memory manager.
+// Payloads are never freed individually; region_release() destroys the region. To support
+// region_realloc(), each payload is preceded by its size.
+//
+
+#include <stdint.h>
+#include <string.h>
+
+#include "dataseg.h"
+#include "memmgr.h"
+#include "regiondriver.h"
+
+static Region *region = NULL;     ///< region of the driver
+
+void* region_malloc(size_t size)
+{
+  if (size > SIZE_MAX - sizeof(size_t)) return NULL;
+  if ((region == NULL) && ((region = mm_region_create(0)) == NULL)) return NULL;
+
+  size_t *p = mm_region_alloc(region, sizeof(size_t) + size);
+  if (p == NULL) return NULL;
+
+  *p = size;
+  return p + 1;
+}
+
+void* region_calloc(size_t nmemb, size_t size)
+{
+  if ((size > 0) && (nmemb > SIZE_MAX / size)) return NULL;
+
+  void *ptr = region_malloc(nmemb*size);
+  if (ptr != NULL) memset(ptr, 0, nmemb*size);
+
+  return ptr;
+}
+
+void* region_realloc(void *ptr, size_t size)
+{
+  if (size == 0) return NULL;
+
+  void *payload = region_malloc(size);
+  if ((payload != NULL) && (ptr != NULL)) {
+    size_t old = ((size_t*)ptr)[-1];
+    memcpy(payload, ptr, old < size ? old : size);
+  }
+
+  return payload;
+}
+
+void region_free(void *ptr)
+{
+}
+
+void region_stat(size_t *size, ssize_t *num_sbrk)
+{
+  if (size) {
+    void *heap_start, *heap_brk;
+    ds_heap_stat(&heap_start, &heap_brk, NULL);
+    *size = heap_brk - heap_start;
+  }
+  if (num_sbrk) *num_sbrk = ds_getnsbrk();
+}
+
+void region_release(void)
+{
+  mm_region_destroy(region);
+  region = NULL;
+}
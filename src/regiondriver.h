@@ -0,0 +1,75 @@
+//--------------------------------------------------------------------------------------------------
+// System Programming                       Memory Lab                                   Spring 2024
+//
+/// @file
+/// @brief region driver (malloc interfaces on top of a memory manager region)
+/// @section changelog Change Log
+/// 2024/05/27 created
+///
+/// @section license_section License
+/// Copyright (c) 2020-2023, Computer Systems and Platforms Laboratory, SNU
+/// All rights reserved.
+///
+/// Redistribution and use in source and binary forms, with or without modification, are permitted
+/// provided that the following conditions are met:
+///
+/// - Redistributions of source code must retain the above copyright notice, this list of condi-
+///   tions and the following disclaimer.
+/// - Redistributions in binary form must reproduce the above copyright notice, this list of condi-
+///   tions and the following disclaimer in the documentation and/or other materials provided with
+///   the distribution.
+///
+/// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+/// IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED  TO,  THE IMPLIED WARRANTIES OF MERCHANTABILITY
+/// AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+/// CONTRIBUTORS BE LIABLE FOR ANY DIRECT,  INDIRECT, INCIDENTAL,  SPECIAL,  EXEMPLARY,  OR CONSE-
+/// QUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,  PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+/// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)   HOWEVER CAUSED AND ON ANY THEORY OF
+/// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,  OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+/// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+/// DAMAGE.
+//--------------------------------------------------------------------------------------------------
+
+#ifndef __REGIONDRIVER_H__
+#define __REGIONDRIVER_H__
+
+#include <stdlib.h>
+
+/// @brief region malloc. Allocates @a size bytes in the driver's region (created on first use).
+/// @param size size of payload
+/// @retval void* pointer to payload
+/// @retval NULL if memory allocation failed
+void* region_malloc(size_t size);
+
+
+/// @brief region calloc. Allocates @a nmemb * @a size zeroed bytes in the driver's region.
+/// @param nmemb number of members
+/// @param size size of one member
+/// @retval void* pointer to payload
+/// @retval NULL if memory allocation failed
+void* region_calloc(size_t nmemb, size_t size);
+
+
+/// @brief region realloc. Allocates @a size bytes and copies the payload of @a ptr.
+/// @param ptr payload or NULL
+/// @param size size of payload
+/// @retval void* pointer to payload
+/// @retval NULL if memory allocation failed or @a size is 0
+void* region_realloc(void *ptr, size_t size);
+
+
+/// @brief region free. Does nothing; the memory is released by region_release().
+/// @param ptr pointer to free
+void region_free(void *ptr);
+
+
+/// @brief region statistics
+/// @param size heap size. Set if not NULL
+/// @param num_sbrk number of sbrk invocations. Set if not NULL
+void region_stat(size_t *size, ssize_t *num_sbrk);
+
+
+/// @brief destroy the driver's region and release all of its payloads at once
+void region_release(void);
+
+#endif // __REGIONDRIVER_H__